@@ -0,0 +1,128 @@
+/**
+ * @file Arena.c
+ * @date 18 october 2026
+ * @brief Arena implementation.
+*/
+
+#include <stdlib.h>
+#include "Arena.h"
+#define BLOCK_HEADER_SIZE ARENA_ROUND_UP(sizeof(ArenaBlock))
+
+/**
+ * @brief constructs a new Arena.
+ * @param blockSize: size of the blocks the arena allocates (larger allocations get their own
+ * block).
+ * @return a new arena. if creation failed, returns NULL.
+ */
+Arena *newArena(size_t blockSize)
+{
+    Arena *arena = (Arena *) calloc(1, sizeof(Arena));
+    if (arena == NULL)
+    {
+        return NULL;
+    }
+    arena->blocks = NULL;
+    arena->blockSize = blockSize;
+    return arena;
+}
+
+/**
+ * @brief allocates memory from the arena, aligned for any type.
+ * @param arena: the arena.
+ * @param size: number of bytes.
+ * @return pointer to the memory, NULL on failure.
+ */
+void *arenaAlloc(Arena *arena, size_t size)
+{
+    if (arena == NULL)
+    {
+        return NULL;
+    }
+    size = ARENA_ROUND_UP(size);
+    ArenaBlock *block = arena->blocks;
+    if (block == NULL || block->size - block->used < size)
+    {
+        size_t blockSize = size > arena->blockSize ? size : arena->blockSize;
+        block = (ArenaBlock *) malloc(BLOCK_HEADER_SIZE + blockSize);
+        if (block == NULL)
+        {
+            return NULL;
+        }
+        block->size = blockSize;
+        block->used = 0;
+        if (size > arena->blockSize && arena->blocks != NULL)
+        {
+            // an oversized block is full right away - keep allocating from the current one.
+            block->next = arena->blocks->next;
+            arena->blocks->next = block;
+        }
+        else
+        {
+            block->next = arena->blocks;
+            arena->blocks = block;
+        }
+    }
+    void *memory = (char *) block + BLOCK_HEADER_SIZE + block->used;
+    block->used += size;
+    return memory;
+}
+
+/**
+ * @brief checks whether a pointer points into memory allocated from the arena.
+ * @param arena: the arena.
+ * @param pointer: the pointer to check.
+ * @return 0 if the pointer is not in the arena, other if it is.
+ */
+int arenaContains(const Arena *arena, const void *pointer)
+{
+    if (arena == NULL || pointer == NULL)
+    {
+        return 0;
+    }
+    for (const ArenaBlock *block = arena->blocks; block != NULL; block = block->next)
+    {
+        const char *start = (const char *) block + BLOCK_HEADER_SIZE;
+        if ((const char *) pointer >= start && (const char *) pointer < start + block->used)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief the memory held by the arena.
+ * @param arena: the arena.
+ * @return number of bytes of all the blocks of the arena.
+ */
+size_t arenaSize(const Arena *arena)
+{
+    size_t size = 0;
+    for (const ArenaBlock *block = arena == NULL ? NULL : arena->blocks; block != NULL;
+         block = block->next)
+    {
+        size += BLOCK_HEADER_SIZE + block->size;
+    }
+    return size;
+}
+
+/**
+ * @brief free the arena and all the memory allocated from it.
+ * @param arena: pointer to the arena to free.
+ */
+void freeArena(Arena **arena)
+{
+    if (arena == NULL || *arena == NULL)
+    {
+        return;
+    }
+    ArenaBlock *block = (*arena)->blocks;
+    while (block != NULL)
+    {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(*arena);
+    *arena = NULL;
+}
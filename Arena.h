@@ -0,0 +1,66 @@
+#ifndef RBTREE_ARENA_H
+#define RBTREE_ARENA_H
+
+#include <stddef.h>
+
+// every allocation of an arena is rounded up to a multiple of this, so it is aligned for any type.
+#define ARENA_ALIGNMENT 16
+#define ARENA_ROUND_UP(size) (((size) + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT)
+
+/**
+ * a block of an arena.
+ */
+typedef struct ArenaBlock
+{
+	struct ArenaBlock *next;
+	size_t size;
+	size_t used;
+} ArenaBlock;
+
+/**
+ * a bump allocator - allocations are carved from large blocks, and are all freed together when
+ * the arena is freed. not thread safe.
+ */
+typedef struct Arena
+{
+	ArenaBlock *blocks;
+	size_t blockSize;
+} Arena;
+
+/**
+ * constructs a new Arena.
+ * @param blockSize: size of the blocks the arena allocates (larger allocations get their own
+ * block).
+ * @return a new arena. if creation failed, returns NULL.
+ */
+Arena *newArena(size_t blockSize);
+
+/**
+ * allocates memory from the arena, aligned for any type.
+ * @param arena: the arena.
+ * @param size: number of bytes.
+ * @return pointer to the memory, NULL on failure.
+ */
+void *arenaAlloc(Arena *arena, size_t size);
+
+/**
+ * checks whether a pointer points into memory allocated from the arena.
+ * @param arena: the arena.
+ * @param pointer: the pointer to check.
+ * @return 0 if the pointer is not in the arena, other if it is.
+ */
+int arenaContains(const Arena *arena, const void *pointer);
+
+/**
+ * @param arena: the arena.
+ * @return number of bytes of all the blocks of the arena.
+ */
+size_t arenaSize(const Arena *arena);
+
+/**
+ * free the arena and all the memory allocated from it.
+ * @param arena: pointer to the arena to free.
+ */
+void freeArena(Arena **arena);
+
+#endif //RBTREE_ARENA_H
@@ -0,0 +1,551 @@
+/**
+ * @file Loader.c
+ * @date 18 october 2026
+ * @brief streaming loaders of strings and vectors from files into trees. a producer thread reads
+ * and parses the file, and the calling thread sorts the parsed batches and inserts them.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include "Loader.h"
+#include "Structs.h"
+#define CHUNK_SIZE (1 << 20)
+#define BATCH_SIZE 4096
+#define QUEUE_CAPACITY 4
+
+/**
+ * the kinds of files the loader parses.
+ */
+typedef enum LoaderFormat
+{
+    LOAD_STRINGS, LOAD_VECTORS_CSV, LOAD_VECTORS_BINARY
+} LoaderFormat;
+
+/**
+ * a batch of parsed items.
+ */
+typedef struct LoaderBatch
+{
+    void *items[BATCH_SIZE];
+    int size;
+} LoaderBatch;
+
+/**
+ * the state of a load, shared by the producer thread and the calling thread.
+ */
+typedef struct Loader
+{
+    FILE *file;
+    LoaderFormat format;
+    Arena *arena;
+    LoaderBatch *current;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    LoaderBatch *queue[QUEUE_CAPACITY];
+    int head;
+    int count;
+    int done;
+    int failed;
+    int stopped;
+} Loader;
+
+/**
+ * @brief allocates the memory of an item - from the arena if the load has one.
+ * @param loader: the load.
+ * @param size: number of bytes.
+ * @return pointer to the memory, NULL on failure.
+ */
+void *allocateItem(Loader *loader, size_t size)
+{
+    return loader->arena != NULL ? arenaAlloc(loader->arena, size) : malloc(size);
+}
+
+/**
+ * @brief frees an item that was not inserted. items of an arena are freed with the arena.
+ * @param loader: the load.
+ * @param item: the item.
+ */
+void discardItem(Loader *loader, void *item)
+{
+    if (loader->arena != NULL)
+    {
+        return;
+    }
+    if (loader->format == LOAD_STRINGS)
+    {
+        freeString(item);
+    }
+    else
+    {
+        freeVector(item);
+    }
+}
+
+/**
+ * @brief hands the current batch to the consumer, waits while the queue is full.
+ * @param loader: the load.
+ * @return 0 if the consumer stopped the load, other on success.
+ */
+int pushBatch(Loader *loader)
+{
+    pthread_mutex_lock(&loader->lock);
+    while (loader->count == QUEUE_CAPACITY && !loader->stopped)
+    {
+        pthread_cond_wait(&loader->changed, &loader->lock);
+    }
+    int status = !loader->stopped;
+    if (status)
+    {
+        loader->queue[(loader->head + loader->count) % QUEUE_CAPACITY] = loader->current;
+        loader->count++;
+        loader->current = NULL;
+        pthread_cond_broadcast(&loader->changed);
+    }
+    pthread_mutex_unlock(&loader->lock);
+    return status;
+}
+
+/**
+ * @brief adds a parsed item to the current batch, hands the batch over when it is full.
+ * @param loader: the load.
+ * @param item: the item, NULL if its allocation failed.
+ * @return 0 on failure, other on success.
+ */
+int addItem(Loader *loader, void *item)
+{
+    if (item == NULL)
+    {
+        return false;
+    }
+    if (loader->current == NULL)
+    {
+        loader->current = (LoaderBatch *) malloc(sizeof(LoaderBatch));
+        if (loader->current == NULL)
+        {
+            discardItem(loader, item);
+            return false;
+        }
+        loader->current->size = 0;
+    }
+    loader->current->items[loader->current->size++] = item;
+    return loader->current->size < BATCH_SIZE || pushBatch(loader);
+}
+
+/**
+ * @brief parses a line into a string.
+ * @param loader: the load.
+ * @param line: the line, terminated by '\0' instead of its newline.
+ * @param len: length of the line.
+ * @return the string, NULL on failure.
+ */
+void *parseString(Loader *loader, const char *line, size_t len)
+{
+    char *string = (char *) allocateItem(loader, len + 1);
+    if (string != NULL)
+    {
+        memcpy(string, line, len + 1);
+    }
+    return string;
+}
+
+/**
+ * @brief allocates a vector. a vector of an arena is allocated with its elements in one piece.
+ * @param loader: the load.
+ * @param len: number of elements.
+ * @return the vector, NULL on failure.
+ */
+Vector *allocateVector(Loader *loader, int len)
+{
+    Vector *vector;
+    if (loader->arena != NULL)
+    {
+        vector = (Vector *) arenaAlloc(loader->arena, sizeof(Vector) + sizeof(double) * len);
+        if (vector != NULL)
+        {
+            vector->len = len;
+            vector->vector = (double *) (vector + 1);
+        }
+        return vector;
+    }
+    vector = (Vector *) malloc(sizeof(Vector));
+    if (vector == NULL)
+    {
+        return NULL;
+    }
+    vector->len = len;
+    vector->vector = (double *) malloc(sizeof(double) * len);
+    if (vector->vector == NULL)
+    {
+        free(vector);
+        return NULL;
+    }
+    return vector;
+}
+
+/**
+ * @brief parses a comma-separated line into a vector.
+ * @param loader: the load.
+ * @param line: the line, terminated by '\0' instead of its newline.
+ * @param len: length of the line.
+ * @return the vector, NULL on failure (allocation failure or a field that is not a number).
+ */
+void *parseCsvVector(Loader *loader, const char *line, size_t len)
+{
+    int elements = 1;
+    for (size_t i = 0; i < len; i++)
+    {
+        elements += line[i] == ',';
+    }
+    Vector *vector = allocateVector(loader, elements);
+    if (vector == NULL)
+    {
+        return NULL;
+    }
+    const char *field = line;
+    for (int i = 0; i < elements; i++)
+    {
+        char *end;
+        vector->vector[i] = strtod(field, &end);
+        while (*end == ' ' || *end == '\t' || *end == '\r')
+        {
+            end++;
+        }
+        if (end == field || (*end != ',' && *end != '\0'))
+        {
+            discardItem(loader, vector);
+            return NULL;
+        }
+        field = end + 1;
+    }
+    return vector;
+}
+
+/**
+ * @brief parses the complete lines in the buffer.
+ * @param loader: the load.
+ * @param buffer: the buffer. it has a spare byte after len.
+ * @param len: number of bytes in the buffer.
+ * @param atEnd: true if the file ended - the last line does not need a newline.
+ * @param consumed: set to the number of bytes parsed.
+ * @return 0 on failure, other on success.
+ */
+int parseLines(Loader *loader, char *buffer, size_t len, int atEnd, size_t *consumed)
+{
+    size_t start = 0;
+    while (start < len)
+    {
+        char *newline = (char *) memchr(buffer + start, '\n', len - start);
+        if (newline == NULL && !atEnd)
+        {
+            break;
+        }
+        size_t end = newline == NULL ? len : (size_t) (newline - buffer);
+        size_t next = newline == NULL ? len : end + 1;
+        if (end > start && buffer[end - 1] == '\r')
+        {
+            end--;
+        }
+        buffer[end] = '\0';
+        if (end > start)
+        {
+            void *item = loader->format == LOAD_STRINGS ?
+                         parseString(loader, buffer + start, end - start) :
+                         parseCsvVector(loader, buffer + start, end - start);
+            if (!addItem(loader, item))
+            {
+                return false;
+            }
+        }
+        start = next;
+    }
+    *consumed = start;
+    return true;
+}
+
+/**
+ * @brief parses the complete binary records in the buffer.
+ * @param loader: the load.
+ * @param buffer: the buffer.
+ * @param len: number of bytes in the buffer.
+ * @param atEnd: true if the file ended - a partial record is an error.
+ * @param consumed: set to the number of bytes parsed.
+ * @return 0 on failure, other on success.
+ */
+int parseBinaryVectors(Loader *loader, char *buffer, size_t len, int atEnd, size_t *consumed)
+{
+    size_t start = 0;
+    while (len - start >= sizeof(int))
+    {
+        int elements;
+        memcpy(&elements, buffer + start, sizeof(int));
+        if (elements < 0)
+        {
+            return false;
+        }
+        size_t recordSize = sizeof(int) + sizeof(double) * elements;
+        if (len - start < recordSize)
+        {
+            break;
+        }
+        if (elements > 0)
+        {
+            Vector *vector = allocateVector(loader, elements);
+            if (vector != NULL)
+            {
+                memcpy(vector->vector, buffer + start + sizeof(int), sizeof(double) * elements);
+            }
+            if (!addItem(loader, vector))
+            {
+                return false;
+            }
+        }
+        start += recordSize;
+    }
+    *consumed = start;
+    return !atEnd || start == len;
+}
+
+/**
+ * @brief the producer thread - reads the file in chunks and parses it into batches.
+ * @param pLoader: pointer to the Loader.
+ * @return NULL.
+ */
+void *produceBatches(void *pLoader)
+{
+    Loader *loader = (Loader *) pLoader;
+    size_t capacity = CHUNK_SIZE, len = 0;
+    char *buffer = (char *) malloc(capacity + 1);
+    int status = buffer != NULL;
+    while (status)
+    {
+        if (capacity - len < CHUNK_SIZE / 2)
+        {
+            // a line or a record larger than the buffer - grow it.
+            char *bigger = (char *) realloc(buffer, capacity * 2 + 1);
+            if (bigger == NULL)
+            {
+                status = false;
+                break;
+            }
+            buffer = bigger;
+            capacity *= 2;
+        }
+        size_t read = fread(buffer + len, 1, capacity - len, loader->file);
+        len += read;
+        int atEnd = read == 0;
+        if (atEnd && ferror(loader->file))
+        {
+            status = false;
+            break;
+        }
+        size_t consumed = 0;
+        status = loader->format == LOAD_VECTORS_BINARY ?
+                 parseBinaryVectors(loader, buffer, len, atEnd, &consumed) :
+                 parseLines(loader, buffer, len, atEnd, &consumed);
+        // keep the partial line (or record) for the next chunk.
+        memmove(buffer, buffer + consumed, len - consumed);
+        len -= consumed;
+        if (atEnd)
+        {
+            break;
+        }
+    }
+    if (status && loader->current != NULL && loader->current->size > 0)
+    {
+        status = pushBatch(loader);
+    }
+    if (loader->current != NULL)
+    {
+        for (int i = 0; i < loader->current->size; i++)
+        {
+            discardItem(loader, loader->current->items[i]);
+        }
+        free(loader->current);
+        loader->current = NULL;
+    }
+    free(buffer);
+    pthread_mutex_lock(&loader->lock);
+    loader->done = true;
+    loader->failed = !status;
+    pthread_cond_broadcast(&loader->changed);
+    pthread_mutex_unlock(&loader->lock);
+    return NULL;
+}
+
+/**
+ * @brief takes the next batch from the queue, waits while it is empty.
+ * @param loader: the load.
+ * @return the batch, NULL if the producer is done.
+ */
+LoaderBatch *popBatch(Loader *loader)
+{
+    pthread_mutex_lock(&loader->lock);
+    while (loader->count == 0 && !loader->done)
+    {
+        pthread_cond_wait(&loader->changed, &loader->lock);
+    }
+    LoaderBatch *batch = NULL;
+    if (loader->count > 0)
+    {
+        batch = loader->queue[loader->head];
+        loader->head = (loader->head + 1) % QUEUE_CAPACITY;
+        loader->count--;
+        pthread_cond_broadcast(&loader->changed);
+    }
+    pthread_mutex_unlock(&loader->lock);
+    return batch;
+}
+
+/**
+ * @brief sorts a batch with the tree's CompareFunc (bottom-up merge sort).
+ * @param items: the items.
+ * @param temp: array of at least size items.
+ * @param size: number of items.
+ * @param compFunc: the compare function.
+ */
+void sortBatch(void **items, void **temp, int size, CompareFunc compFunc)
+{
+    void **from = items, **to = temp;
+    for (int width = 1; width < size; width *= 2)
+    {
+        for (int lo = 0; lo < size; lo += 2 * width)
+        {
+            int mid = lo + width < size ? lo + width : size;
+            int hi = lo + 2 * width < size ? lo + 2 * width : size;
+            int i = lo, j = mid, k = lo;
+            while (i < mid && j < hi)
+            {
+                to[k++] = compFunc(from[j], from[i]) < 0 ? from[j++] : from[i++];
+            }
+            while (i < mid)
+            {
+                to[k++] = from[i++];
+            }
+            while (j < hi)
+            {
+                to[k++] = from[j++];
+            }
+        }
+        void **swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != items)
+    {
+        memcpy(items, from, sizeof(void *) * size);
+    }
+}
+
+/**
+ * @brief runs a load - starts the producer, and inserts its batches into the tree.
+ * @param tree: the tree.
+ * @param path: path of the file.
+ * @param format: the format of the file.
+ * @param arena: the arena to allocate the items from, NULL to use malloc.
+ * @return 0 on failure, other on success.
+ */
+int loadToRBTree(RBTree *tree, const char *path, LoaderFormat format, Arena *arena)
+{
+    if (tree == NULL || tree->compFunc == NULL || path == NULL ||
+        (arena != NULL && tree->freeFunc != NULL))
+    {
+        return false;
+    }
+    Loader loader;
+    memset(&loader, 0, sizeof(Loader));
+    loader.format = format;
+    loader.arena = arena;
+    loader.file = fopen(path, format == LOAD_VECTORS_BINARY ? "rb" : "r");
+    if (loader.file == NULL)
+    {
+        return false;
+    }
+    void **temp = (void **) malloc(sizeof(void *) * BATCH_SIZE);
+    pthread_t producer;
+    if (temp == NULL || pthread_mutex_init(&loader.lock, NULL) != 0)
+    {
+        free(temp);
+        fclose(loader.file);
+        return false;
+    }
+    pthread_cond_init(&loader.changed, NULL);
+    int status = pthread_create(&producer, NULL, produceBatches, &loader) == 0;
+    LoaderBatch *batch;
+    while (status && (batch = popBatch(&loader)) != NULL)
+    {
+        // sorted batches insert next to each other, so their paths stay in cache.
+        sortBatch(batch->items, temp, batch->size, tree->compFunc);
+        for (int i = 0; i < batch->size; i++)
+        {
+            if (!status || !insertToRBTree(tree, batch->items[i]))
+            {
+                status = status && RBTreeContains(tree, batch->items[i]);
+                discardItem(&loader, batch->items[i]);
+            }
+        }
+        free(batch);
+        if (!status)
+        {
+            // stop the producer, and drop what it already parsed.
+            pthread_mutex_lock(&loader.lock);
+            loader.stopped = true;
+            pthread_cond_broadcast(&loader.changed);
+            pthread_mutex_unlock(&loader.lock);
+            while ((batch = popBatch(&loader)) != NULL)
+            {
+                for (int i = 0; i < batch->size; i++)
+                {
+                    discardItem(&loader, batch->items[i]);
+                }
+                free(batch);
+            }
+        }
+    }
+    if (status || loader.stopped)
+    {
+        pthread_join(producer, NULL);
+        status = status && !loader.failed;
+    }
+    pthread_cond_destroy(&loader.changed);
+    pthread_mutex_destroy(&loader.lock);
+    free(temp);
+    fclose(loader.file);
+    return status;
+}
+
+/**
+ * @brief inserts all the lines of a file into a tree of strings. the file is read in large chunks
+ * and parsed on a separate thread, and the strings are inserted in sorted batches. lines that are
+ * already in the tree are skipped.
+ * @param tree: a tree of strings.
+ * @param path: path of a file of newline-delimited strings.
+ * @param arena: the arena to allocate the strings from - the tree must have a NULL FreeFunc and
+ * the arena must outlive it. NULL to allocate every string with malloc (to be freed with
+ * freeString).
+ * @return 0 on failure, other on success.
+ */
+int loadStringsToRBTree(RBTree *tree, const char *path, Arena *arena)
+{
+    return loadToRBTree(tree, path, LOAD_STRINGS, arena);
+}
+
+/**
+ * @brief inserts all the vectors of a file into a tree of Vectors. the file is read in large
+ * chunks and parsed on a separate thread, and the vectors are inserted in sorted batches. vectors
+ * that are already in the tree are skipped.
+ * @param tree: a tree of Vectors.
+ * @param path: path of a file of vectors.
+ * @param format: the format of the file.
+ * @param arena: the arena to allocate the vectors from - the tree must have a NULL FreeFunc and
+ * the arena must outlive it. NULL to allocate every vector with malloc (to be freed with
+ * freeVector).
+ * @return 0 on failure, other on success.
+ */
+int loadVectorsToRBTree(RBTree *tree, const char *path, VectorFileFormat format, Arena *arena)
+{
+    return loadToRBTree(tree, path, format == VECTOR_FILE_BINARY ? LOAD_VECTORS_BINARY :
+                                    LOAD_VECTORS_CSV, arena);
+}
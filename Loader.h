@@ -0,0 +1,45 @@
+#ifndef RBTREE_LOADER_H
+#define RBTREE_LOADER_H
+
+#include "RBTree.h"
+#include "Arena.h"
+
+/**
+ * the format of a file of vectors.
+ * VECTOR_FILE_CSV: one vector per line, its elements separated by commas.
+ * VECTOR_FILE_BINARY: records of an int (the length) followed by that many doubles, in the byte
+ * order of the machine.
+ */
+typedef enum VectorFileFormat
+{
+	VECTOR_FILE_CSV, VECTOR_FILE_BINARY
+} VectorFileFormat;
+
+/**
+ * inserts all the lines of a file into a tree of strings. the file is read in large chunks and
+ * parsed on a separate thread, and the strings are inserted in sorted batches. lines that are
+ * already in the tree are skipped.
+ * @param tree: a tree of strings.
+ * @param path: path of a file of newline-delimited strings.
+ * @param arena: the arena to allocate the strings from - the tree must have a NULL FreeFunc and
+ * the arena must outlive it. NULL to allocate every string with malloc (to be freed with
+ * freeString).
+ * @return: 0 on failure, other on success.
+ */
+int loadStringsToRBTree(RBTree *tree, const char *path, Arena *arena);
+
+/**
+ * inserts all the vectors of a file into a tree of Vectors. the file is read in large chunks and
+ * parsed on a separate thread, and the vectors are inserted in sorted batches. vectors that are
+ * already in the tree are skipped.
+ * @param tree: a tree of Vectors.
+ * @param path: path of a file of vectors.
+ * @param format: the format of the file.
+ * @param arena: the arena to allocate the vectors from - the tree must have a NULL FreeFunc and
+ * the arena must outlive it. NULL to allocate every vector with malloc (to be freed with
+ * freeVector).
+ * @return: 0 on failure, other on success.
+ */
+int loadVectorsToRBTree(RBTree *tree, const char *path, VectorFileFormat format, Arena *arena);
+
+#endif //RBTREE_LOADER_H
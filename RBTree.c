@@ -10,17 +10,59 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#define LESS (-1)
+#define GREATER (1)
+#define LOOKUP_GROUP_SIZE 16
+#define REBUILD_FRACTION 4
+#define INITIAL_HOLDERS_CAPACITY 64
+#define HOLDERS_TOMBSTONE ((const void *) &holdersTombstone)
+#ifdef __GNUC__
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address) ((void) (address))
+#endif
 void fix(Node *node, RBTree *tree);
 void deleteCase1(RBTree *tree, Node* node);
+Node* successor(Node *node);
+Node* predecessor(Node *node);
+void releaseItem(RBTree *tree, void *removed);
+void leaveCloneFamily(RBTree *tree);
+Node *ownNode(RBTree *tree, Node **link, Node *parent);
+Node *ownSibling(RBTree *tree, Node *node);
+int ownPath(RBTree *tree, const void *data, unsigned long long prefix, int removal,
+            Node **existing, Node **parent, int *comparison);
+Node *findNodeToWrite(RBTree *tree, const void *data, int removal);
+int ownAllNodes(RBTree *tree);
+Node *releaseLink(RBTree *tree, Node *node, long unsigned *released);
+int dropPayloadHolder(CloneFamily *family, const void *payload);
+int isItemHeldByClone(const RBTree *tree, const void *payload);
+
+// the address of a tombstone in the holder tables of a clone family.
+static const char holdersTombstone = 0;
+int addFamilyArena(CloneFamily *family, Arena *arena);
+
+/**
+ * @brief the size of the nodes of a tree - a PrefixNode if it has a KeyPrefixFunc.
+ * @param tree: the tree.
+ * @return the size of a node.
+ */
+size_t getNodeSize(const RBTree *tree)
+{
+    return tree->prefixFunc == NULL ? sizeof(Node) : sizeof(PrefixNode);
+}
 
 /**
  * @brief creates a new node.
  * @param data - node's data.
+ * @param size - the size of the node (getNodeSize).
  * @return the new node.
  */
-Node *newNode(void *data)
+Node *newNode(void *data, size_t size)
 {
-    Node *newNode = (Node *) calloc(1, sizeof(Node));
+    Node *newNode = (Node *) calloc(1, size);
     if (newNode == NULL)
     {
         return NULL;
@@ -30,6 +72,9 @@ Node *newNode(void *data)
     newNode->data = data;
     newNode->parent = NULL; //?
     newNode->color = RED;
+    newNode->rank = 1;
+    newNode->count = 1;
+    newNode->subtreeSize = 1;
     return newNode;
 }
 
@@ -50,9 +95,195 @@ RBTree *newRBTree(CompareFunc compFunc, FreeFunc freeFunc)
     newRBTree->size = 0; // INITIAL_SIZE?
     newRBTree->compFunc = compFunc;
     newRBTree->freeFunc = freeFunc;
+    newRBTree->prefixFunc = NULL;
+    newRBTree->lcpCompFunc = NULL;
+    newRBTree->multiset = false;
+    newRBTree->finger = NULL;
+    newRBTree->sizeFunc = NULL;
+    newRBTree->arena = NULL;
+    newRBTree->heapBytes = 0;
+    newRBTree->family = NULL;
+    newRBTree->policy = BALANCE_RED_BLACK;
+    newRBTree->rotations = 0;
     return newRBTree;
 }
 
+/**
+ * @brief constructs a new tree that keeps itself balanced by the given policy.
+ * @param compFunc: a function to compare two items.
+ * @param freeFunc: a function to free an item.
+ * @param policy: the balancing policy.
+ * @return a new tree. if creation failed, returns NULL.
+ */
+RBTree *newRBTreeWithPolicy(CompareFunc compFunc, FreeFunc freeFunc, BalancePolicy policy)
+{
+    if (policy != BALANCE_RED_BLACK && policy != BALANCE_AVL && policy != BALANCE_TREAP)
+    {
+        return NULL;
+    }
+    RBTree *tree = newRBTree(compFunc, freeFunc);
+    if (tree != NULL)
+    {
+        tree->policy = policy;
+    }
+    return tree;
+}
+
+/**
+ * @brief sets an LcpCompareFunc to the tree. descents from the root then track the common prefix
+ * of the searched item with the closest smaller and larger items on the way, and every comparison
+ * skips the shorter of the two - all the items between them share it with the searched item.
+ * @param tree: the tree.
+ * @param lcpCompFunc: a function that orders the items exactly as the tree's CompareFunc (NULL to
+ * compare with the CompareFunc only).
+ * @return 0 on failure, other on success.
+ */
+int setRBTreeLcpCompare(RBTree *tree, LcpCompareFunc lcpCompFunc)
+{
+    if (tree == NULL)
+    {
+        return false;
+    }
+    tree->lcpCompFunc = lcpCompFunc;
+    return true;
+}
+
+/**
+ * @brief turns the tree into a multiset (or back into a set). in a multiset, inserting an item
+ * that is already in the tree counts it again in the node of the equal item (one descent), and
+ * the inserted duplicate is freed with the tree's FreeFunc. size counts distinct items.
+ * @param tree: an empty tree.
+ * @param multiset: other than 0 for a multiset, 0 for a set.
+ * @return 0 on failure, other on success. (if the tree is not empty - failure).
+ */
+int setRBTreeMultiset(RBTree *tree, int multiset)
+{
+    if (tree == NULL || tree->root != NULL)
+    {
+        return false;
+    }
+    tree->multiset = multiset != 0;
+    return true;
+}
+
+/**
+ * @brief sets a KeyPrefixFunc to the tree. the prefix of every item is computed once, when it is
+ * inserted, and kept in its node - comparisons call the CompareFunc only when the prefixes tie.
+ * @param tree: an empty tree.
+ * @param prefixFunc: the prefix function of the tree's items (NULL to compare full items only).
+ * @return 0 on failure, other on success. (if the tree is not empty - failure).
+ */
+int setRBTreeKeyPrefix(RBTree *tree, KeyPrefixFunc prefixFunc)
+{
+    if (tree == NULL || tree->root != NULL)
+    {
+        return false;
+    }
+    tree->prefixFunc = prefixFunc;
+    return true;
+}
+
+/**
+ * @brief sets a SizeFunc to the tree, so RBTreeMemoryUsage counts the memory of the items too.
+ * @param tree: an empty tree.
+ * @param sizeFunc: the size function of the tree's items (NULL to count the nodes only).
+ * @return 0 on failure, other on success. (if the tree is not empty - failure).
+ */
+int setRBTreeSizeFunc(RBTree *tree, SizeFunc sizeFunc)
+{
+    if (tree == NULL || tree->root != NULL)
+    {
+        return false;
+    }
+    tree->sizeFunc = sizeFunc;
+    return true;
+}
+
+/**
+ * @brief the memory an item holds, if the tree has a SizeFunc.
+ * @param tree: the tree.
+ * @param data: the item.
+ * @return number of bytes of the item, 0 if the tree has no SizeFunc.
+ */
+size_t getItemSize(const RBTree *tree, const void *data)
+{
+    return tree->sizeFunc == NULL ? 0 : tree->sizeFunc(data);
+}
+
+/**
+ * @brief computes the key prefix of an item, if the tree has a KeyPrefixFunc.
+ * @param tree: the tree.
+ * @param data: the item.
+ * @return the prefix of the item, 0 if the tree has no KeyPrefixFunc.
+ */
+unsigned long long getKeyPrefix(const RBTree *tree, const void *data)
+{
+    return tree->prefixFunc == NULL ? 0 : tree->prefixFunc(data);
+}
+
+/**
+ * @brief compares an item to the item of a node - by the key prefixes first, and by the
+ * CompareFunc only if they tie.
+ * @param tree: the tree.
+ * @param data: the item.
+ * @param prefix: the key prefix of the item.
+ * @param node: the node.
+ * @return lower than 0 if data is smaller than the node's item, 0 if equal, greater than 0 if
+ * larger.
+ */
+int compareToNode(const RBTree *tree, const void *data, unsigned long long prefix,
+                  const Node *node)
+{
+    if (tree->prefixFunc != NULL && prefix != NODE_KEY_PREFIX(node))
+    {
+        return prefix < NODE_KEY_PREFIX(node) ? LESS : GREATER;
+    }
+    return tree->compFunc(data, node->data);
+}
+
+/**
+ * @brief compares an item to the item of a node on a descent, with the tree's LcpCompareFunc if
+ * it has one. a comparison the key prefixes decide tells nothing of the common prefix, so it
+ * counts as 0.
+ * @param tree: the tree.
+ * @param data: the item.
+ * @param prefix: the key prefix of the item.
+ * @param node: the node.
+ * @param lcpLow: the common prefix of the item and the closest smaller item above node (0 if
+ * there is none). set to the common prefix with node if the item is larger.
+ * @param lcpHigh: the same, with the closest larger item above node.
+ * @return lower than 0 if data is smaller than the node's item, 0 if equal, greater than 0 if
+ * larger.
+ */
+int compareOnDescent(const RBTree *tree, const void *data, unsigned long long prefix,
+                     const Node *node, size_t *lcpLow, size_t *lcpHigh)
+{
+    if (tree->lcpCompFunc == NULL)
+    {
+        return compareToNode(tree, data, prefix, node);
+    }
+    int comparison;
+    size_t lcp = 0;
+    if (tree->prefixFunc != NULL && prefix != NODE_KEY_PREFIX(node))
+    {
+        comparison = prefix < NODE_KEY_PREFIX(node) ? LESS : GREATER;
+    }
+    else
+    {
+        comparison = tree->lcpCompFunc(data, node->data, *lcpLow < *lcpHigh ? *lcpLow : *lcpHigh,
+                                       &lcp);
+    }
+    if (comparison < 0)
+    {
+        *lcpHigh = lcp;
+    }
+    else if (comparison > 0)
+    {
+        *lcpLow = lcp;
+    }
+    return comparison;
+}
+
 /**
  * @brief swap a node with his child (left or right).
  * @param tree: RB tree.
@@ -83,38 +314,127 @@ void replaceWithChild(RBTree *tree, Node *node, Node *child)
 }
 
 /**
- * @brief finds a place to a new node according to BST rules, and inserts it.
- * @param root: tree's root
- * @param node: node to insert.
- * @param comparator: compare function that exist in RBTree.
+ * @brief descends from a node to the place of an item according to BST rules.
+ * @param tree: the tree.
+ * @param start: the node to start from - the root, or a node whose sub-tree covers the item.
+ * @param data: the item.
+ * @param prefix: the key prefix of the item.
+ * @param parent: set to the node a new node of the item should be a child of (NULL if the tree is
+ * empty).
+ * @param comparison: set to the comparison of the item and parent (lower than 0 - a left child).
+ * @return the node with an item equal to data, NULL if there is none.
  */
-void findAndAdd(Node *root, Node* node, CompareFunc comparator)
+Node *findPlace(const RBTree *tree, Node *start, const void *data, unsigned long long prefix,
+                Node **parent, int *comparison)
 {
-    if (comparator(node->data, root->data) < 0)
+    Node *nodePtr = start;
+    size_t lcpLow = 0, lcpHigh = 0;
+    *parent = NULL;
+    *comparison = 0;
+    while (nodePtr != NULL)
     {
-        if (root->left != NULL)
+        *comparison = compareOnDescent(tree, data, prefix, nodePtr, &lcpLow, &lcpHigh);
+        if (*comparison == 0)
         {
-            findAndAdd(root->left, node, comparator);
-            return;
+            return nodePtr;
         }
-        else
+        *parent = nodePtr;
+        nodePtr = *comparison < 0 ? nodePtr->left : nodePtr->right;
+    }
+    return NULL;
+}
+
+/**
+ * @brief tries to place an item in the gap right before or right after the finger (the last
+ * inserted node) - the place of the next item of a nearly sorted stream.
+ * @param tree: the tree. tree->finger is not NULL.
+ * @param data: the item.
+ * @param prefix: the key prefix of the item.
+ * @param existing: set to the node with an item equal to data, NULL if there is none.
+ * @param parent, comparison: set as in findPlace, if there is no existing node.
+ * @return true if the place was found, false if the item is not next to the finger.
+ */
+int findPlaceNearFinger(const RBTree *tree, const void *data, unsigned long long prefix,
+                        Node **existing, Node **parent, int *comparison)
+{
+    Node *finger = tree->finger;
+    int fingerComparison = compareToNode(tree, data, prefix, finger);
+    *existing = NULL;
+    if (fingerComparison == 0)
+    {
+        *existing = finger;
+        return true;
+    }
+    Node *neighbor = fingerComparison > 0 ? successor(finger) : predecessor(finger);
+    if (neighbor != NULL)
+    {
+        int neighborComparison = compareToNode(tree, data, prefix, neighbor);
+        if (neighborComparison == 0)
+        {
+            *existing = neighbor;
+            return true;
+        }
+        if ((neighborComparison > 0) == (fingerComparison > 0))
         {
-            root->left = node;
+            // beyond the neighbor.
+            return false;
         }
     }
+    // the item is between the finger and its neighbor - and one of them has a free child there.
+    if (fingerComparison > 0)
+    {
+        *parent = finger->right == NULL ? finger : neighbor;
+        *comparison = finger->right == NULL ? GREATER : LESS;
+    }
     else
     {
-        if (root->right != NULL)
+        *parent = finger->left == NULL ? finger : neighbor;
+        *comparison = finger->left == NULL ? LESS : GREATER;
+    }
+    return true;
+}
+
+/**
+ * @brief climbs from a hint node to the lowest ancestor whose sub-tree covers the item. the range
+ * of a sub-tree is bounded by the nearest ancestors it is the right / left descendant of.
+ * @param tree: the tree.
+ * @param hint: a node of the tree.
+ * @param data: the item.
+ * @param prefix: the key prefix of the item.
+ * @return the node to start the descent from.
+ */
+Node *climbFromHint(const RBTree *tree, Node *hint, const void *data, unsigned long long prefix)
+{
+    Node *start = hint;
+    while (start->parent != NULL)
+    {
+        Node *lower = NULL, *upper = NULL, *node = start;
+        while (node->parent != NULL && (lower == NULL || upper == NULL))
         {
-            findAndAdd(root->right, node, comparator);
-            return;
+            if (node == node->parent->left)
+            {
+                upper = upper == NULL ? node->parent : upper;
+            }
+            else
+            {
+                lower = lower == NULL ? node->parent : lower;
+            }
+            node = node->parent;
+        }
+        if (lower != NULL && compareToNode(tree, data, prefix, lower) <= 0)
+        {
+            start = lower;
+        }
+        else if (upper != NULL && compareToNode(tree, data, prefix, upper) >= 0)
+        {
+            start = upper;
         }
         else
         {
-            root->right = node;
+            break;
         }
     }
-    node->parent = root;
+    return start;
 }
 
 /**
@@ -129,25 +449,47 @@ Color getColor(Node* node)
 
 
 /**
- * @brief check whether the tree RBTreeContains this item.
- * @param tree: the tree to add an item to.
- * @param data: item to check.
- * @return 0 if the item is not in the tree, other if it is.
+ * @brief the size of the sub-tree of a node.
+ * @param node: the node, may be NULL.
+ * @return number of nodes in the sub-tree, 0 for NULL.
  */
-int RBTreeContains(const RBTree *tree, const void *data)
+long unsigned getSubtreeSize(const Node *node)
+{
+    return node == NULL ? 0 : node->subtreeSize;
+}
+
+/**
+ * @brief recomputes the size of the sub-tree of a node from its children.
+ * @param node: the node.
+ */
+void updateSubtreeSize(Node *node)
+{
+    node->subtreeSize = getSubtreeSize(node->left) + getSubtreeSize(node->right) + 1;
+}
+
+/**
+ * @brief returns a pointer to the node with the given data in tree.
+ * @param tree: RBtree we want to find a node in.
+ * @param data: data of the node that we want to find.
+ * @return a pointer to the node with the given data in tree, NULL if there is no such node.
+ */
+Node* findNode(const RBTree *tree, const void *data)
 {
     if (tree == NULL || data == NULL || tree->compFunc == NULL || tree->root == NULL)
     {
-        return false;
+        return NULL;
     }
     Node* nodePtr = tree->root;
+    unsigned long long prefix = getKeyPrefix(tree, data);
+    size_t lcpLow = 0, lcpHigh = 0;
     while (nodePtr != NULL)
     {
-        if (tree->compFunc(nodePtr->data, data) == 0)
+        int comparison = compareOnDescent(tree, data, prefix, nodePtr, &lcpLow, &lcpHigh);
+        if (comparison == 0)
         {
-            return true;
+            return nodePtr;
         }
-        else if (tree->compFunc(nodePtr->data, data) < 0)
+        else if (comparison > 0)
         {
             nodePtr = nodePtr->right;
         }
@@ -156,39 +498,147 @@ int RBTreeContains(const RBTree *tree, const void *data)
             nodePtr = nodePtr->left;
         }
     }
+    return NULL;
+}
+
+/**
+ * @brief check whether the tree RBTreeContains this item.
+ * @param tree: the tree to add an item to.
+ * @param data: item to check.
+ * @return 0 if the item is not in the tree, other if it is.
+ */
+int RBTreeContains(const RBTree *tree, const void *data)
+{
+    return findNode(tree, data) != NULL;
+}
+
+/**
+ * one search of RBTreeContainsBatch. a search that reaches a node whose item it has to compare
+ * only prefetches the item, and compares it on its next step.
+ */
+typedef struct Lookup
+{
+    const Node *node;
+    const void *data;
+    unsigned long long prefix;
+    int index;
+    int compare;
+} Lookup;
+
+/**
+ * @brief advances a search by one step - one node, or one comparison with the item of a node.
+ * the next node is prefetched, so it is hopefully in the cache by the time the search gets to it.
+ * @param tree: the tree to search in.
+ * @param lookup: the search.
+ * @param results: the results of the batch. set when the search ends.
+ * @return true if the search ended, false otherwise.
+ */
+int advanceLookup(const RBTree *tree, Lookup *lookup, int *results)
+{
+    const Node *node = lookup->node;
+    int comparison;
+    if (lookup->compare)
+    {
+        comparison = tree->compFunc(lookup->data, node->data);
+        lookup->compare = false;
+    }
+    else if (tree->prefixFunc != NULL && lookup->prefix != NODE_KEY_PREFIX(node))
+    {
+        comparison = lookup->prefix < NODE_KEY_PREFIX(node) ? LESS : GREATER;
+    }
+    else
+    {
+        PREFETCH(node->data);
+        lookup->compare = true;
+        return false;
+    }
+    const Node *next = comparison > 0 ? node->right : node->left;
+    if (comparison == 0 || next == NULL)
+    {
+        results[lookup->index] = comparison == 0;
+        return true;
+    }
+    PREFETCH(next);
+    lookup->node = next;
     return false;
 }
 
 /**
- * @brief assumes that RBTree contains node with given data (we check it before). returns a
- * pointer to a node with the given data in tree.
- * @param tree: RBtree we want to delete a node from.
- * @param data: data of a node that we want to delete.
- * @return a pointer to a node with the given data in tree.
+ * @brief check which of the items are in the tree. up to LOOKUP_GROUP_SIZE searches walk down the
+ * tree in lock-step, each prefetching its next node while the others advance, so their cache
+ * misses overlap instead of following one another.
+ * @param tree: the tree to search in.
+ * @param items: the items to check.
+ * @param numItems: number of items.
+ * @param results: array of numItems, results[i] is set to 0 if items[i] is not in the tree, 1 if
+ * it is.
+ * @return 0 on failure, other on success.
  */
-Node* findNodeToDelete (const RBTree *tree, const void *data)
+int RBTreeContainsBatch(const RBTree *tree, const void *const *items, int numItems, int *results)
 {
-    if (tree == NULL || data == NULL || tree->compFunc == NULL || tree->root == NULL)
+    if (tree == NULL || tree->compFunc == NULL || numItems < 0 ||
+        (numItems > 0 && (items == NULL || results == NULL)))
     {
-        return NULL;
+        return false;
     }
-    Node* nodePtr = tree->root;
-    while (nodePtr != NULL)
+    Lookup lookups[LOOKUP_GROUP_SIZE];
+    int active = 0, next = 0;
+    while (active > 0 || next < numItems)
     {
-        if (tree->compFunc(nodePtr->data, data) == 0)
-        {
-            return nodePtr;
-        }
-        else if (tree->compFunc(nodePtr->data, data) < 0)
+        // a search that ended is replaced right away, so the group stays full.
+        while (active < LOOKUP_GROUP_SIZE && next < numItems)
         {
-            nodePtr = nodePtr->right;
+            if (items[next] == NULL || tree->root == NULL)
+            {
+                results[next++] = false;
+                continue;
+            }
+            Lookup *lookup = &lookups[active++];
+            lookup->node = tree->root;
+            lookup->data = items[next];
+            lookup->prefix = getKeyPrefix(tree, items[next]);
+            lookup->index = next++;
+            lookup->compare = false;
         }
-        else
+        for (int i = 0; i < active;)
         {
-            nodePtr = nodePtr->left;
+            if (advanceLookup(tree, &lookups[i], results))
+            {
+                lookups[i] = lookups[--active];
+            }
+            else
+            {
+                i++;
+            }
         }
     }
-    return false;
+    return true;
+}
+
+/**
+ * @brief count the occurrences of an item in the tree.
+ * @param tree: the tree to search in.
+ * @param data: item to count.
+ * @return number of times the item was inserted into a multiset (and not removed), 0 or 1 in a
+ * set.
+ */
+long unsigned RBTreeCount(const RBTree *tree, const void *data)
+{
+    Node *node = findNode(tree, data);
+    return node == NULL ? 0 : node->count;
+}
+
+/**
+ * @brief find the item of the tree that is equal to the given one.
+ * @param tree: the tree to search in.
+ * @param data: item to search.
+ * @return the item as it is stored in the tree (borrowed - owned by the tree unless it has a NULL
+ * FreeFunc), NULL if it is not in the tree.
+ */
+const void *RBTreeFind(const RBTree *tree, const void *data)
+{
+    Node *node = findNode(tree, data);
+    return node == NULL ? NULL : node->data;
 }
 
 
@@ -244,9 +694,8 @@ Node* findUncle(Node *node)
  */
 void insertCase3(Node *node, RBTree *tree)
 {
-    Node *uncle = findUncle(node);
     node->parent->color = BLACK;
-    uncle->color = BLACK;
+    ownSibling(tree, node->parent)->color = BLACK;
     node->parent->parent->color = RED;
     fix(node->parent->parent, tree);
 }
@@ -257,7 +706,7 @@ void insertCase3(Node *node, RBTree *tree)
  */
 void leftRotate(Node *node, RBTree* tree)
 {
-    Node* right = node->right;
+    Node* right = ownNode(tree, &node->right, node);
     replaceWithChild(tree, node, right);
     node->right = right->left;
     if (right->left != NULL)
@@ -266,6 +715,9 @@ void leftRotate(Node *node, RBTree* tree)
     }
     right->left = node;
     node->parent = right;
+    right->subtreeSize = node->subtreeSize;
+    updateSubtreeSize(node);
+    tree->rotations++;
 }
 
 /**
@@ -274,7 +726,7 @@ void leftRotate(Node *node, RBTree* tree)
  */
 void rightRotate(Node *node, RBTree *tree)
 {
-    Node *left = node->left;
+    Node *left = ownNode(tree, &node->left, node);
     replaceWithChild(tree, node, left);
     node->left = left->right;
     if (left->right != NULL)
@@ -283,6 +735,9 @@ void rightRotate(Node *node, RBTree *tree)
     }
     left->right = node;
     node->parent = left;
+    left->subtreeSize = node->subtreeSize;
+    updateSubtreeSize(node);
+    tree->rotations++;
 }
 
 /**
@@ -357,112 +812,376 @@ void fix(Node *node, RBTree *tree)
     }
 }
 
+//-------------- AVL and treap balancing. ----------------
+
 /**
- * @brief add an item to the tree
- * @param tree: the tree to add an item to.
- * @param data: item to add to the tree.
- * @return 0 on failure, other on success. (if the item is already in the tree - failure).
+ * @brief the rank of a node - its height in an AVL tree, its priority in a treap.
+ * @param node: the node, may be NULL.
+ * @return the rank of the node, 0 for NULL.
  */
-int insertToRBTree(RBTree *tree, void *data)
+int getRank(const Node *node)
 {
-    if ((RBTreeContains(tree, data)) || tree == NULL || data == NULL)
-    {
-        return false;
-    }
-    Node *toAdd = newNode(data);
-    if (tree->root == NULL)
+    return node == NULL ? 0 : node->rank;
+}
+
+/**
+ * @brief recomputes the AVL height of a node from its children.
+ * @param node: the node.
+ */
+void updateHeight(Node *node)
+{
+    int left = getRank(node->left), right = getRank(node->right);
+    node->rank = (left > right ? left : right) + 1;
+}
+
+/**
+ * @brief rotates an AVL sub-tree and updates the heights of the two rotated nodes.
+ * @param tree: the tree.
+ * @param node: node of the rotation.
+ * @param left: other than 0 for a left rotation, 0 for a right rotation.
+ * @return the new root of the sub-tree.
+ */
+Node *rotateAVL(RBTree *tree, Node *node, int left)
+{
+    if (left)
     {
-        toAdd->color = BLACK;
-        tree->root = toAdd;
-        tree->size++;
-        return true;
+        leftRotate(node, tree);
     }
     else
     {
-        findAndAdd(tree->root, toAdd, tree->compFunc);
-    }
-    fix(toAdd, tree);
-    Node *temp = toAdd;
-    while (temp->parent != NULL)
-    {
-        temp = temp->parent;
+        rightRotate(node, tree);
     }
-    tree->root = temp;
-    tree->size++;
-    return true;
+    updateHeight(node);
+    updateHeight(node->parent);
+    return node->parent;
 }
 
 /**
- * @brief gets a node and find the minimal node in its sub-tree.
- * @param node: this node is the root of the sub-tree we find the minimal node in.
- * @return a pointer to the minimal node.
+ * @brief restores the AVL balance after a node was added or removed below a node - from the node
+ * up, until a sub-tree keeps its height.
+ * @param tree: the tree.
+ * @param node: the lowest node whose height may have changed, may be NULL.
  */
-Node* minNode(Node *node)
+void rebalanceAVL(RBTree *tree, Node *node)
 {
-    if (node == NULL)
-    {
-        return NULL;
-    }
-    else
+    while (node != NULL)
     {
-        Node* curr = node;
-        // the minimal node is the leftmost leaf in the subtree.
-        while (curr->left != NULL)
+        int oldHeight = node->rank;
+        updateHeight(node);
+        int balance = getRank(node->left) - getRank(node->right);
+        if (balance > 1)
         {
-            curr = curr->left;
+            if (getRank(node->left->left) < getRank(node->left->right))
+            {
+                rotateAVL(tree, ownNode(tree, &node->left, node), true);
+            }
+            node = rotateAVL(tree, node, false);
         }
-        return curr;
+        else if (balance < -1)
+        {
+            if (getRank(node->right->right) < getRank(node->right->left))
+            {
+                rotateAVL(tree, ownNode(tree, &node->right, node), false);
+            }
+            node = rotateAVL(tree, node, true);
+        }
+        if (node->rank == oldHeight)
+        {
+            return;
+        }
+        node = node->parent;
     }
-
 }
 
 /**
- * @brief find's a given node its successor node, in-order traversal.
- * @param root: tree's root.
- * @param node: node to fins its successor.
- * @return a pointer to successor.
+ * @brief a random priority for a new treap node. the address of the node is hashed (by the
+ * splitmix64 finalizer), so the priorities need no state and are independent of the items.
+ * @param node: the node.
+ * @return a priority between 0 and INT32_MAX.
  */
-Node* successor(Node *node)
+int getTreapPriority(const Node *node)
 {
-    if (node->right != NULL)
-    {
-        return minNode(node->right);
-    }
-    Node *ptr = node->parent;
-    while (ptr != NULL && node == ptr->right)
-    {
-        node = ptr;
-        ptr = ptr->parent;
-    }
-    return ptr;
+    uint64_t bits = (uint64_t) (uintptr_t) node;
+    bits = (bits ^ (bits >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    bits = (bits ^ (bits >> 27)) * 0x94d049bb133111ebULL;
+    bits ^= bits >> 31;
+    return (int) (bits >> 33);
 }
 
 /**
- * @brief helper to forEachRBTree - tracks every node in order traversal anf implies func on
- * every node.
- * @param tree: tree to traverse.
- * @param func: func to imply.
- * @param args: arg of func - can be null.
- * @param min: current node, we start at min.
- * @return: true if succeeded, else false.
+ * @brief rotates a new treap node up until its parent has a priority no lower than its own.
+ * @param tree: the tree.
+ * @param node: the new node.
  */
-int forEachRBTreeHelper(const RBTree *tree, forEachFunc func, void *args, Node* min)
+void siftUpTreap(RBTree *tree, Node *node)
 {
-    if (min == NULL || min->data == NULL)
-    {
-        return true;
-    }
-    if (!func(min->data, args))
+    while (node->parent != NULL && node->parent->rank < node->rank)
     {
-        return false;
-    }
-    if (successor(min) != NULL)
-    {
-        forEachRBTreeHelper(tree, func, args, successor(min));
-    }
-    // if we got here, we are at the right-most node.
+        if (node == node->parent->left)
+        {
+            rightRotate(node->parent, tree);
+        }
+        else
+        {
+            leftRotate(node->parent, tree);
+        }
+    }
+}
+
+/**
+ * @brief adds an item at a place found by findPlace (or an equal existing node).
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @param prefix: the key prefix of the item.
+ * @param existing: the node with an item equal to data, NULL if there is none.
+ * @param parent, comparison: the place of the new node, as set by findPlace.
+ * @return 0 on failure, other on success. (if the item is already in the tree - failure, unless
+ * the tree is a multiset).
+ */
+int addAtPlace(RBTree *tree, void *data, unsigned long long prefix, Node *existing, Node *parent,
+               int comparison)
+{
+    if (existing != NULL)
+    {
+        if (!tree->multiset)
+        {
+            return false;
+        }
+        existing->count++;
+        if (data != existing->data && tree->freeFunc != NULL)
+        {
+            tree->freeFunc(data);
+        }
+        tree->finger = existing;
+        return true;
+    }
+    Node *toAdd = newNode(data, getNodeSize(tree));
+    if (toAdd == NULL)
+    {
+        return false;
+    }
+    if (tree->prefixFunc != NULL)
+    {
+        NODE_KEY_PREFIX(toAdd) = prefix;
+    }
+    tree->heapBytes += getNodeSize(tree) + getItemSize(tree, data);
+    tree->size++;
+    tree->finger = toAdd;
+    if (parent == NULL)
+    {
+        toAdd->color = BLACK;
+        tree->root = toAdd;
+        return true;
+    }
+    if (comparison < 0)
+    {
+        parent->left = toAdd;
+    }
+    else
+    {
+        parent->right = toAdd;
+    }
+    toAdd->parent = parent;
+    for (Node *ancestor = parent; ancestor != NULL; ancestor = ancestor->parent)
+    {
+        ancestor->subtreeSize++;
+    }
+    // rotations that reach the root update tree->root (replaceWithChild).
+    if (tree->policy == BALANCE_AVL)
+    {
+        rebalanceAVL(tree, parent);
+    }
+    else if (tree->policy == BALANCE_TREAP)
+    {
+        toAdd->rank = getTreapPriority(toAdd);
+        siftUpTreap(tree, toAdd);
+    }
+    else
+    {
+        fix(toAdd, tree);
+    }
     return true;
+}
+
+/**
+ * @brief add an item to the tree
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @return 0 on failure, other on success. (if the item is already in the tree - failure, unless
+ * the tree is a multiset).
+ */
+int insertToRBTree(RBTree *tree, void *data)
+{
+    if (tree == NULL || data == NULL || tree->compFunc == NULL)
+    {
+        return false;
+    }
+    unsigned long long prefix = getKeyPrefix(tree, data);
+    Node *existing, *parent;
+    int comparison;
+    if (tree->family != NULL)
+    {
+        // a tree with clones copies the nodes it shares with them on the way down.
+        if (!ownPath(tree, data, prefix, false, &existing, &parent, &comparison))
+        {
+            return false;
+        }
+    }
+    else if (tree->finger == NULL ||
+             !findPlaceNearFinger(tree, data, prefix, &existing, &parent, &comparison))
+    {
+        existing = findPlace(tree, tree->root, data, prefix, &parent, &comparison);
+    }
+    return addAtPlace(tree, data, prefix, existing, parent, comparison);
+}
+
+/**
+ * @brief add an item to the tree, searching for its place from a node that is expected to be
+ * near it (climbing up from the hint only as far as needed, then down) instead of from the root.
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @param hint: a node of the tree (for example tree->finger), NULL to search from the root.
+ * @return 0 on failure, other on success. (same as insertToRBTree).
+ */
+int insertToRBTreeWithHint(RBTree *tree, void *data, Node *hint)
+{
+    if (tree == NULL || data == NULL || tree->compFunc == NULL)
+    {
+        return false;
+    }
+    if (tree->family != NULL)
+    {
+        // the climb needs the parents, which the nodes of a tree with clones do not keep.
+        return insertToRBTree(tree, data);
+    }
+    unsigned long long prefix = getKeyPrefix(tree, data);
+    Node *start = hint == NULL ? tree->root : climbFromHint(tree, hint, data, prefix);
+    Node *parent;
+    int comparison;
+    Node *existing = findPlace(tree, start, data, prefix, &parent, &comparison);
+    return addAtPlace(tree, data, prefix, existing, parent, comparison);
+}
+
+/**
+ * @brief sets the parent of a node that a descent reached from it. a node that a tree shares with
+ * its clones may have another parent in each of them, so its parent is the one the last descent
+ * through it set - a walk that climbs back up has to set the parents on its way down. in a tree
+ * without clones the parents are always set already, and nothing is written.
+ * @param child: the node, may be NULL.
+ * @param parent: the node the descent came from, NULL for the root.
+ * @return the node.
+ */
+Node *setParentOnDescent(Node *child, Node *parent)
+{
+    if (child != NULL && child->parent != parent)
+    {
+        child->parent = parent;
+    }
+    return child;
+}
+
+/**
+ * @brief gets a node and find the minimal node in its sub-tree.
+ * @param node: this node is the root of the sub-tree we find the minimal node in.
+ * @return a pointer to the minimal node.
+ */
+Node* minNode(Node *node)
+{
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    else
+    {
+        Node* curr = node;
+        // the minimal node is the leftmost leaf in the subtree.
+        while (curr->left != NULL)
+        {
+            curr = setParentOnDescent(curr->left, curr);
+        }
+        return curr;
+    }
+
+}
+
+/**
+ * @brief gets a node and find the maximal node in its sub-tree.
+ * @param node: this node is the root of the sub-tree we find the maximal node in.
+ * @return a pointer to the maximal node.
+ */
+Node* maxNode(Node *node)
+{
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    while (node->right != NULL)
+    {
+        node = setParentOnDescent(node->right, node);
+    }
+    return node;
+}
+
+/**
+ * @brief find's a given node its predecessor node, in-order traversal.
+ * @param node: node to find its predecessor.
+ * @return a pointer to predecessor.
+ */
+Node* predecessor(Node *node)
+{
+    if (node->left != NULL)
+    {
+        return maxNode(setParentOnDescent(node->left, node));
+    }
+    Node *ptr = node->parent;
+    while (ptr != NULL && node == ptr->left)
+    {
+        node = ptr;
+        ptr = ptr->parent;
+    }
+    return ptr;
+}
+
+/**
+ * @brief find's a given node its successor node, in-order traversal.
+ * @param root: tree's root.
+ * @param node: node to fins its successor.
+ * @return a pointer to successor.
+ */
+Node* successor(Node *node)
+{
+    if (node->right != NULL)
+    {
+        return minNode(setParentOnDescent(node->right, node));
+    }
+    Node *ptr = node->parent;
+    while (ptr != NULL && node == ptr->right)
+    {
+        node = ptr;
+        ptr = ptr->parent;
+    }
+    return ptr;
+}
+
+/**
+ * @brief returns the node of the smallest item in the tree - together with RBTreeNext, walks the
+ * tree in ascending order.
+ * @param tree: the tree to iterate.
+ * @return the node of the smallest item in the tree, NULL if the tree is empty.
+ */
+Node *RBTreeFirst(const RBTree *tree)
+{
+    return tree == NULL ? NULL : minNode(setParentOnDescent(tree->root, NULL));
+}
 
+/**
+ * @brief returns the node of the next item in ascending order.
+ * @param node: a node of a tree.
+ * @return the node of the next item, NULL if node holds the largest item.
+ */
+Node *RBTreeNext(const Node *node)
+{
+    return node == NULL ? NULL : successor((Node *) node);
 }
 
  /**
@@ -479,48 +1198,201 @@ int forEachRBTree(const RBTree *tree, forEachFunc func, void *args)
     {
         return false;
     }
-    Node* min = minNode(tree->root);
-    return forEachRBTreeHelper(tree, func, args, min);
+    for (Node *node = RBTreeFirst(tree); node != NULL; node = successor(node))
+    {
+        if (!func(node->data, args))
+        {
+            return false;
+        }
+    }
+    return true;
 }
 
 /**
- * @brief gets a single node and a free function, and frees its sub-tree.
- * @param node: root.
- * @param freeFunc: tree's free func.
+ * @brief frees the nodes of the tree iteratively, in bounded steps: the left child of the root is
+ * rotated up until the root has none, then the root is freed and its right child takes its place.
+ * needs no recursion and no extra memory, whatever the shape of the tree. the items are released
+ * with releaseItem, and nodes in the tree's arena are not freed. in a tree with clones, only the
+ * nodes the tree holds alone are freed - the sub-trees it shares are left to the clones
+ * (releaseLink).
+ * @param tree: the tree. its root is set to the root of what is left of it.
+ * @param budget: maximal number of steps (a rotation or a free), 0 for no limit.
+ * @return number of nodes freed or left to clones.
  */
-void freeSubTree(Node* node, FreeFunc freeFunc)
+long unsigned freeSubTree(RBTree *tree, long unsigned budget)
 {
-    if (node == NULL)
+    long unsigned freed = 0, steps = 0;
+    Node *node = releaseLink(tree, tree->root, &freed);
+    while (node != NULL && (budget == 0 || steps < budget))
+    {
+        steps++;
+        Node *left = releaseLink(tree, node->left, &freed);
+        if (left != NULL)
+        {
+            node->left = left->right;
+            left->right = node;
+            node = left;
+        }
+        else
+        {
+            Node *right = releaseLink(tree, node->right, &freed);
+            releaseItem(tree, node->data);
+            if (!arenaContains(tree->arena, node))
+            {
+                free(node);
+            }
+            freed++;
+            node = right;
+        }
+    }
+    tree->root = node;
+    return freed;
+}
+
+/**
+ * @brief free all memory of the data structure. the items are freed only if the tree has a
+ * FreeFunc (and no clone holds them).
+ * @param tree: pointer to the tree to free.
+ */
+void freeRBTree(RBTree **tree)
+{
+    if (tree == NULL || (*tree) == NULL)
     {
         return;
     }
-    if (node->left != NULL)
+    freeSubTree(*tree, 0);
+    leaveCloneFamily(*tree);
+    free(*tree);
+    *tree = NULL;
+}
+
+/**
+ * @brief frees a bounded part of the tree, so a huge tree can be freed in small time slices.
+ * after the first call the tree is being torn down - it may only be passed to this function
+ * again (or to freeRBTree).
+ * @param tree: pointer to the tree to free. set to NULL once it is freed completely.
+ * @param budget: maximal number of steps in this call (each step is a rotation or one free).
+ * @return number of nodes left to free. 0 means the tree is freed.
+ */
+long unsigned freeRBTreeStep(RBTree **tree, long unsigned budget)
+{
+    if (tree == NULL || (*tree) == NULL)
     {
-        freeSubTree(node->left, freeFunc);
+        return 0;
     }
-    if (node->right != NULL)
+    (*tree)->finger = NULL;
+    (*tree)->size -= freeSubTree(*tree, budget == 0 ? 1 : budget);
+    if ((*tree)->root != NULL)
+    {
+        return (*tree)->size;
+    }
+    leaveCloneFamily(*tree);
+    free(*tree);
+    *tree = NULL;
+    return 0;
+}
+
+/**
+ * a tree waiting for the background reclaimer.
+ */
+typedef struct ReclaimJob
+{
+    RBTree *tree;
+    struct ReclaimJob *next;
+} ReclaimJob;
+
+static pthread_mutex_t reclaimerLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reclaimerChanged = PTHREAD_COND_INITIALIZER;
+static ReclaimJob *reclaimQueue = NULL;
+static int reclaimerStarted = false;
+static int reclaimerBusy = false;
+
+/**
+ * @brief the background reclaimer thread - frees the trees handed to it, one after the other.
+ * @param args: unused.
+ * @return never returns.
+ */
+void *reclaimTrees(void *args)
+{
+    (void) args;
+    pthread_mutex_lock(&reclaimerLock);
+    while (true)
     {
-        freeSubTree(node->right, freeFunc);
+        while (reclaimQueue == NULL)
+        {
+            reclaimerBusy = false;
+            pthread_cond_broadcast(&reclaimerChanged);
+            pthread_cond_wait(&reclaimerChanged, &reclaimerLock);
+        }
+        ReclaimJob *job = reclaimQueue;
+        reclaimQueue = job->next;
+        reclaimerBusy = true;
+        pthread_mutex_unlock(&reclaimerLock);
+        freeRBTree(&job->tree);
+        free(job);
+        pthread_mutex_lock(&reclaimerLock);
     }
-    freeFunc(node->data);
-    free(node);
+    return NULL;
 }
 
 /**
- * @brief free all memory of the data structure.
- * @param tree: pointer to the tree to free.
+ * @brief hands the tree to a background thread that frees it, so the caller does not wait for a
+ * huge tree to be torn down. the tree's FreeFunc is called on that thread.
+ * @param tree: pointer to the tree to free. set to NULL.
  */
-void freeRBTree(RBTree **tree)
+void freeRBTreeInBackground(RBTree **tree)
 {
-    if ((*tree) == NULL || (*tree)->freeFunc == NULL)
+    if (tree == NULL || (*tree) == NULL)
     {
         return;
     }
-    freeSubTree((*tree)->root, (*tree)->freeFunc);
-    free(*tree);
+    if ((*tree)->family != NULL)
+    {
+        // the reference counts of a family are not thread safe.
+        freeRBTree(tree);
+        return;
+    }
+    ReclaimJob *job = (ReclaimJob *) malloc(sizeof(ReclaimJob));
+    pthread_mutex_lock(&reclaimerLock);
+    if (job != NULL && !reclaimerStarted)
+    {
+        pthread_t reclaimer;
+        reclaimerStarted = pthread_create(&reclaimer, NULL, reclaimTrees, NULL) == 0;
+        if (reclaimerStarted)
+        {
+            pthread_detach(reclaimer);
+        }
+    }
+    if (job == NULL || !reclaimerStarted)
+    {
+        // no reclaimer - free it here.
+        pthread_mutex_unlock(&reclaimerLock);
+        free(job);
+        freeRBTree(tree);
+        return;
+    }
+    job->tree = *tree;
+    job->next = reclaimQueue;
+    reclaimQueue = job;
+    reclaimerBusy = true;
+    pthread_cond_broadcast(&reclaimerChanged);
+    pthread_mutex_unlock(&reclaimerLock);
     *tree = NULL;
 }
 
+/**
+ * @brief waits until the background reclaimer freed all the trees handed to it.
+ */
+void waitForRBTreeReclaimer(void)
+{
+    pthread_mutex_lock(&reclaimerLock);
+    while (reclaimQueue != NULL || reclaimerBusy)
+    {
+        pthread_cond_wait(&reclaimerChanged, &reclaimerLock);
+    }
+    pthread_mutex_unlock(&reclaimerLock);
+}
+
 //-------------- delete from RB-tree. ----------------
 
 /**
@@ -554,16 +1426,17 @@ Node* getSibling(Node *node)
  */
 void deleteCase6(RBTree* tree, Node* node)
 {
-    getSibling(node)->color = getColor(node->parent);
+    Node *sibling = ownSibling(tree, node);
+    sibling->color = getColor(node->parent);
     node->parent->color = BLACK;
     if (node == node->parent->left)
     {
-        getSibling(node)->right->color = BLACK;
+        ownNode(tree, &sibling->right, sibling)->color = BLACK;
         leftRotate(node->parent, tree);
     }
     else
     {
-        getSibling(node)->left->color = BLACK;
+        ownNode(tree, &sibling->left, sibling)->color = BLACK;
         rightRotate(node->parent, tree);
     }
 }
@@ -581,18 +1454,20 @@ void deleteCase5(RBTree *tree, Node* node)
         getColor(getSibling(node)->left) == RED &&
         getColor(getSibling(node)->right) == BLACK)
     {
-        getSibling(node)->color = RED;
-        getSibling(node)->left->color = BLACK;
-        rightRotate(getSibling(node), tree);
+        Node *sibling = ownSibling(tree, node);
+        sibling->color = RED;
+        ownNode(tree, &sibling->left, sibling)->color = BLACK;
+        rightRotate(sibling, tree);
     }
     else if (node == node->parent->right &&
              getColor(getSibling(node)) == BLACK &&
              getColor(getSibling(node)->right) == RED &&
              getColor(getSibling(node)->left) == BLACK)
     {
-        getSibling(node)->color = RED;
-        getSibling(node)->right->color = BLACK;
-        leftRotate(getSibling(node), tree);
+        Node *sibling = ownSibling(tree, node);
+        sibling->color = RED;
+        ownNode(tree, &sibling->right, sibling)->color = BLACK;
+        leftRotate(sibling, tree);
     }
     deleteCase6(tree, node);
 }
@@ -610,7 +1485,7 @@ void deleteCase4(RBTree *tree, Node* node)
         getColor(getSibling(node)->left) == BLACK &&
         getColor(getSibling(node)->right) == BLACK)
     {
-        getSibling(node)->color = RED;
+        ownSibling(tree, node)->color = RED;
         node->parent->color = BLACK;
     }
     else
@@ -632,7 +1507,7 @@ void deleteCase3(RBTree *tree, Node* node)
         getColor(getSibling(node)->left) == BLACK &&
         getColor(getSibling(node)->right) == BLACK)
     {
-        getSibling(node)->color = RED;
+        ownSibling(tree, node)->color = RED;
         deleteCase1(tree, node->parent);
     }
     else
@@ -652,7 +1527,7 @@ void deleteCase2(RBTree *tree, Node *node)
     if (getColor(getSibling(node)) == RED)
     {
         node->parent->color = RED;
-        getSibling(node)->color = BLACK;
+        ownSibling(tree, node)->color = BLACK;
         if (node == node->parent->left)
         {
             leftRotate(node->parent, tree);
@@ -684,47 +1559,1194 @@ void deleteCase1(RBTree *tree, Node* node)
 }
 
 /**
- * remove an item from the tree
- * @param tree: the tree to remove an item from.
- * @param data: item to remove from the tree.
- * @return: 0 on failure, other on success. (if data is not in the tree - failure).
+ * @brief frees a node that was unlinked from the tree, and takes it and an item that was removed
+ * with it off the tree's accounts. nodes in the tree's arena are not freed.
+ * @param tree: the tree.
+ * @param node: the unlinked node.
+ * @param removed: the removed item.
  */
-int deleteFromRBTree(RBTree *tree, void *data)
+void discardNode(RBTree *tree, Node *node, const void *removed)
 {
-    if ((!RBTreeContains(tree, data)) || tree == NULL || data == NULL)
+    if (tree->finger == node)
     {
-        return false;
+        tree->finger = NULL;
     }
-    // get a pointer to the node:
-    Node *toDelete = findNodeToDelete(tree, data);
-    Node *child;
-    if (toDelete->left == NULL || toDelete->right == NULL)
+    if (!arenaContains(tree->arena, removed))
+    {
+        tree->heapBytes -= getItemSize(tree, removed);
+    }
+    if (!arenaContains(tree->arena, node))
     {
-        free(toDelete->data);
+        tree->heapBytes -= getNodeSize(tree);
+        free(node);
     }
+    tree->size--;
+}
+
+/**
+ * @brief unlinks a node from the tree and frees it, without freeing its item. note that if the
+ * node has two children, the successor's item moves into it and the successor's node is freed.
+ * @param tree: the tree to remove the node from.
+ * @param toDelete: the node.
+ * @return the item of the removed node.
+ */
+void *removeNode(RBTree *tree, Node *toDelete)
+{
+    void *removed = toDelete->data;
+    Node *child;
     // if node has two non-leaf children:
     if (toDelete->left != NULL && toDelete->right != NULL) // if node has to children
     {
         Node *successorNode = successor(toDelete);
-        free(toDelete->data);
         toDelete->data = successorNode->data;
+        if (tree->prefixFunc != NULL)
+        {
+            NODE_KEY_PREFIX(toDelete) = NODE_KEY_PREFIX(successorNode);
+        }
+        toDelete->count = successorNode->count;
         toDelete = successorNode;
     }
     // now node has at most 1 non-leaf child.
     assert(toDelete->left == NULL || toDelete->right == NULL);
     child = toDelete->right == NULL ? toDelete->left : toDelete->right;
-    if (getColor(toDelete) == BLACK)
+    // the sizes drop before the fix-up, so its rotations see the sizes the tree will have.
+    for (Node *ancestor = toDelete; ancestor != NULL; ancestor = ancestor->parent)
+    {
+        ancestor->subtreeSize--;
+    }
+    // a treap needs no fix-up: the child's priority is no higher than the removed node's.
+    if (tree->policy == BALANCE_RED_BLACK && getColor(toDelete) == BLACK)
     {
         toDelete->color = getColor(child);
         deleteCase1(tree, toDelete);
     }
     replaceWithChild(tree, toDelete, child);
-    if (toDelete->parent == NULL && child != NULL)
+    if (tree->policy == BALANCE_RED_BLACK && toDelete->parent == NULL && child != NULL)
     {
-        child->color = BLACK;
+        ownNode(tree, &tree->root, NULL)->color = BLACK;
 
     }
-    free(toDelete);
-    tree->size--;
-    return true;
-}
\ No newline at end of file
+    else if (tree->policy == BALANCE_AVL)
+    {
+        rebalanceAVL(tree, toDelete->parent);
+    }
+    discardNode(tree, toDelete, removed);
+    return removed;
+}
+
+/**
+ * @brief frees an item that was removed from the tree with the tree's FreeFunc, unless the tree
+ * has none, the item lives in the tree's arena, or a clone of the tree still holds it.
+ * @param tree: the tree.
+ * @param removed: the removed item.
+ */
+void releaseItem(RBTree *tree, void *removed)
+{
+    if (tree->freeFunc != NULL && !arenaContains(tree->arena, removed) &&
+        (tree->family == NULL || dropPayloadHolder(tree->family, removed)))
+    {
+        tree->freeFunc(removed);
+    }
+}
+
+/**
+ * @brief remove an item from the tree without freeing it - the ownership of the item moves to the
+ * caller. an item that a clone of the tree still holds cannot be handed over, so it is not
+ * removed.
+ * @param tree: the tree to remove an item from.
+ * @param data: item equal to the one to remove.
+ * @return the removed item as it was stored in the tree, NULL if data is not in the tree or a
+ * clone still holds it.
+ */
+void *removeFromRBTree(RBTree *tree, const void *data)
+{
+    if (tree == NULL)
+    {
+        return NULL;
+    }
+    // get a pointer to the node - in a tree with clones, the tree's own copy of it.
+    Node *toDelete = findNodeToWrite(tree, data, true);
+    if (toDelete == NULL || isItemHeldByClone(tree, toDelete->data))
+    {
+        return NULL;
+    }
+    void *removed = removeNode(tree, toDelete);
+    if (tree->family != NULL)
+    {
+        // the tree's own hold - the last one.
+        dropPayloadHolder(tree->family, removed);
+    }
+    return removed;
+}
+
+/**
+ * remove an item from the tree (all its occurrences, in a multiset), and free it with the tree's
+ * FreeFunc (if it has one).
+ * @param tree: the tree to remove an item from.
+ * @param data: item to remove from the tree.
+ * @return: 0 on failure, other on success. (if data is not in the tree - failure).
+ */
+int deleteFromRBTree(RBTree *tree, void *data)
+{
+    if (tree == NULL)
+    {
+        return false;
+    }
+    Node *toDelete = findNodeToWrite(tree, data, true);
+    if (toDelete == NULL)
+    {
+        return false;
+    }
+    // the item is freed only if no clone holds it (releaseItem).
+    releaseItem(tree, removeNode(tree, toDelete));
+    return true;
+}
+
+/**
+ * @brief remove one occurrence of an item from a multiset - decrements its count, and deletes it
+ * (as deleteFromRBTree) when the count drops to 0. in a set, same as deleteFromRBTree.
+ * @param tree: the tree to remove an item from.
+ * @param data: item to remove from the tree.
+ * @return 0 on failure, other on success. (if data is not in the tree - failure).
+ */
+int decrementInRBTree(RBTree *tree, void *data)
+{
+    if (tree == NULL)
+    {
+        return false;
+    }
+    Node *node = findNodeToWrite(tree, data, true);
+    if (node == NULL)
+    {
+        return false;
+    }
+    if (node->count > 1)
+    {
+        node->count--;
+        return true;
+    }
+    void *removed = removeNode(tree, node);
+    releaseItem(tree, removed);
+    return true;
+}
+
+//-------------- range operations. ----------------
+
+/**
+ * @brief counts the items of the tree that are smaller than an item (or equal to it).
+ * @param tree: the tree.
+ * @param data: the item.
+ * @param inclusive: true to count an item equal to data too.
+ * @return number of such items.
+ */
+long unsigned countBelow(const RBTree *tree, const void *data, int inclusive)
+{
+    long unsigned rank = 0;
+    unsigned long long prefix = getKeyPrefix(tree, data);
+    const Node *node = tree->root;
+    while (node != NULL)
+    {
+        int comparison = compareToNode(tree, data, prefix, node);
+        if (comparison == 0)
+        {
+            return rank + getSubtreeSize(node->left) + (inclusive ? 1 : 0);
+        }
+        if (comparison < 0)
+        {
+            node = node->left;
+        }
+        else
+        {
+            rank += getSubtreeSize(node->left) + 1;
+            node = node->right;
+        }
+    }
+    return rank;
+}
+
+/**
+ * @brief finds the node of the smallest item that is not smaller than an item.
+ * @param tree: the tree.
+ * @param data: the item, NULL for the smallest item of the tree.
+ * @return the node, NULL if all the items are smaller.
+ */
+Node *lowerBoundNode(const RBTree *tree, const void *data)
+{
+    if (data == NULL)
+    {
+        return RBTreeFirst(tree);
+    }
+    unsigned long long prefix = getKeyPrefix(tree, data);
+    Node *node = tree->root, *bound = NULL;
+    while (node != NULL)
+    {
+        int comparison = compareToNode(tree, data, prefix, node);
+        if (comparison > 0)
+        {
+            node = node->right;
+            continue;
+        }
+        bound = node;
+        if (comparison == 0)
+        {
+            break;
+        }
+        node = node->left;
+    }
+    return bound;
+}
+
+/**
+ * @brief count the items of the tree in a range, by the sizes of the sub-trees.
+ * @param tree: the tree to count in.
+ * @param low: the smallest item of the range (inclusive), NULL for no lower bound.
+ * @param high: the largest item of the range (inclusive), NULL for no upper bound.
+ * @return number of items of the tree in the range.
+ */
+long unsigned RBTreeCountRange(const RBTree *tree, const void *low, const void *high)
+{
+    if (tree == NULL || tree->compFunc == NULL ||
+        (low != NULL && high != NULL && tree->compFunc(low, high) > 0))
+    {
+        return 0;
+    }
+    long unsigned below = low == NULL ? 0 : countBelow(tree, low, false);
+    long unsigned upTo = high == NULL ? tree->size : countBelow(tree, high, true);
+    return upTo > below ? upTo - below : 0;
+}
+
+/**
+ * @brief the rank of an item - the number of items of the tree that are smaller than it.
+ * @param tree: the tree.
+ * @param data: the item (it does not have to be in the tree).
+ * @return the rank of the item.
+ */
+long unsigned RBTreeRank(const RBTree *tree, const void *data)
+{
+    if (tree == NULL || data == NULL || tree->compFunc == NULL)
+    {
+        return 0;
+    }
+    return countBelow(tree, data, false);
+}
+
+/**
+ * @brief finds the node of the item of a given rank, by the sizes of the sub-trees.
+ * @param tree: the tree.
+ * @param rank: the rank - 0 for the smallest item.
+ * @return the node, NULL if rank is not smaller than the size of the tree.
+ */
+Node *RBTreeSelect(const RBTree *tree, long unsigned rank)
+{
+    Node *node = tree == NULL ? NULL : setParentOnDescent(tree->root, NULL);
+    while (node != NULL)
+    {
+        long unsigned leftSize = getSubtreeSize(node->left);
+        if (rank == leftSize)
+        {
+            return node;
+        }
+        if (rank < leftSize)
+        {
+            node = setParentOnDescent(node->left, node);
+        }
+        else
+        {
+            rank -= leftSize + 1;
+            node = setParentOnDescent(node->right, node);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief builds a balanced tree of nodes. all the levels but the deepest are full, so the nodes of
+ * the deepest level are colored red and all the others black, and it is an AVL tree too.
+ * @param nodes: the nodes, in order.
+ * @param size: number of nodes.
+ * @param depth: the depth of the root of the built tree in the whole tree.
+ * @param redDepth: the deepest level of the whole tree.
+ * @return the root of the built tree (its parent is not set).
+ */
+Node *buildBalanced(Node **nodes, long unsigned size, int depth, int redDepth)
+{
+    if (size == 0)
+    {
+        return NULL;
+    }
+    long unsigned middle = size / 2;
+    Node *node = nodes[middle];
+    node->left = buildBalanced(nodes, middle, depth + 1, redDepth);
+    node->right = buildBalanced(nodes + middle + 1, size - middle - 1, depth + 1, redDepth);
+    if (node->left != NULL)
+    {
+        node->left->parent = node;
+    }
+    if (node->right != NULL)
+    {
+        node->right->parent = node;
+    }
+    node->color = depth == redDepth && depth > 0 ? RED : BLACK;
+    updateHeight(node);
+    node->subtreeSize = size;
+    return node;
+}
+
+/**
+ * @brief removes a range of the tree node by node - from its first node along the successors. in
+ * a tree with clones, the path to every node is copied before it is removed (findNodeToWrite),
+ * which may fail.
+ * @param tree: the tree.
+ * @param low: the smallest item of the range (inclusive), NULL for no lower bound.
+ * @param count: number of items in the range.
+ * @param removed: set to the removed items. if NULL, they are freed right away.
+ * @return number of items removed - count, unless copying a path failed.
+ */
+long unsigned deleteRangeInPlace(RBTree *tree, const void *low, long unsigned count,
+                                 void **removed)
+{
+    Node *node = lowerBoundNode(tree, low);
+    for (long unsigned i = 0; i < count; i++)
+    {
+        if (tree->family != NULL && (node = findNodeToWrite(tree, node->data, true)) == NULL)
+        {
+            return i;
+        }
+        // with two children, the successor's item moves into the node (removeNode).
+        Node *next = node->left != NULL && node->right != NULL ? node : successor(node);
+        void *data = removeNode(tree, node);
+        if (removed != NULL)
+        {
+            removed[i] = data;
+        }
+        else
+        {
+            releaseItem(tree, data);
+        }
+        node = next;
+    }
+    return count;
+}
+
+/**
+ * @brief removes a range of the tree by rebuilding the tree from the nodes that are left.
+ * @param tree: the tree.
+ * @param first: number of items before the range.
+ * @param count: number of items in the range.
+ * @param removed: set to the removed items. if NULL, they are freed right away.
+ * @return 0 on failure (the tree is unchanged), other on success.
+ */
+int deleteRangeByRebuild(RBTree *tree, long unsigned first, long unsigned count, void **removed)
+{
+    long unsigned size = tree->size;
+    Node **nodes = (Node **) malloc(size * sizeof(Node *));
+    if (nodes == NULL)
+    {
+        return false;
+    }
+    long unsigned i = 0;
+    for (Node *node = RBTreeFirst(tree); node != NULL; node = successor(node))
+    {
+        nodes[i++] = node;
+    }
+    for (i = first; i < first + count; i++)
+    {
+        void *data = nodes[i]->data;
+        discardNode(tree, nodes[i], data);
+        if (removed != NULL)
+        {
+            removed[i - first] = data;
+        }
+        else
+        {
+            releaseItem(tree, data);
+        }
+    }
+    long unsigned left = size - count;
+    memmove(nodes + first, nodes + first + count, (left - first) * sizeof(Node *));
+    int redDepth = 0;
+    while ((left >> (redDepth + 1)) > 0)
+    {
+        redDepth++;
+    }
+    tree->root = buildBalanced(nodes, left, 0, redDepth);
+    if (tree->root != NULL)
+    {
+        tree->root->parent = NULL;
+    }
+    free(nodes);
+    return true;
+}
+
+/**
+ * @brief remove all the items of the tree in a range, and free them with the tree's FreeFunc
+ * once the tree is rebalanced. a small range is removed node by node - its first node is found
+ * once, and the rest are its successors - and a range of most of the tree by rebuilding the
+ * tree from the nodes that are left.
+ * @param tree: the tree to remove the items from.
+ * @param low: the smallest item of the range (inclusive), NULL for no lower bound.
+ * @param high: the largest item of the range (inclusive), NULL for no upper bound.
+ * @return number of items removed.
+ */
+long unsigned RBTreeDeleteRange(RBTree *tree, const void *low, const void *high)
+{
+    long unsigned count = RBTreeCountRange(tree, low, high);
+    if (count == 0)
+    {
+        return 0;
+    }
+    // if there is no room for the removed items, they are freed one by one instead.
+    void **removed = (void **) malloc(count * sizeof(void *));
+    // a rebuilt tree would lose the heap order of a treap's priorities. a tree with clones is
+    // rebuilt from copies of all its nodes.
+    if (count <= tree->size / REBUILD_FRACTION || tree->policy == BALANCE_TREAP ||
+        !ownAllNodes(tree) ||
+        !deleteRangeByRebuild(tree, low == NULL ? 0 : countBelow(tree, low, false), count,
+                              removed))
+    {
+        count = deleteRangeInPlace(tree, low, count, removed);
+    }
+    if (removed != NULL)
+    {
+        for (long unsigned i = 0; i < count; i++)
+        {
+            releaseItem(tree, removed[i]);
+        }
+        free(removed);
+    }
+    return count;
+}
+
+/**
+ * @brief the height of the tree. the nodes are walked along their parent pointers - down to the
+ * left child, then to the right one, then back up - so the walk needs no stack. the parents are
+ * set on the way down (setParentOnDescent).
+ * @param tree: the tree.
+ * @return number of nodes on the longest path from the root down (0 for an empty tree).
+ */
+int RBTreeHeight(const RBTree *tree)
+{
+    if (tree == NULL)
+    {
+        return 0;
+    }
+    int height = 0, depth = 1;
+    Node *node = setParentOnDescent(tree->root, NULL), *previous = NULL;
+    while (node != NULL)
+    {
+        Node *next;
+        if (previous == node->parent)
+        {
+            height = depth > height ? depth : height;
+            next = node->left != NULL ? node->left : node->right;
+        }
+        else
+        {
+            next = previous == node->left ? node->right : NULL;
+        }
+        previous = node;
+        if (next != NULL)
+        {
+            node = setParentOnDescent(next, node);
+            depth++;
+        }
+        else
+        {
+            node = node->parent;
+            depth--;
+        }
+    }
+    return height;
+}
+
+//-------------- memory accounting and compaction. ----------------
+
+/**
+ * @brief the memory the tree holds.
+ * @param tree: the tree.
+ * @return number of bytes of the tree, its nodes, its items (as told by its SizeFunc) and the
+ * arena of the last compaction.
+ */
+size_t RBTreeMemoryUsage(const RBTree *tree)
+{
+    if (tree == NULL)
+    {
+        return 0;
+    }
+    size_t usage = sizeof(RBTree) + tree->heapBytes;
+    if (tree->arena != NULL)
+    {
+        usage += sizeof(Arena) + arenaSize(tree->arena);
+    }
+    return usage;
+}
+
+/**
+ * @brief copies the nodes of the tree (and their items, with a RelocateFunc) into a new arena, in
+ * in-order order. the tree itself is not changed.
+ * @param tree: the tree.
+ * @param relocateFunc: copies an item into the arena, may be NULL.
+ * @param olds: set to the nodes of the tree, in order.
+ * @param copies: set to their copies, in the same order. their pointers still point to old nodes.
+ * @param heapBytes: set to the memory of the items that stay outside the new arena.
+ * @return the new arena, NULL on failure.
+ */
+Arena *copyNodesToArena(const RBTree *tree, RelocateFunc relocateFunc, Node **olds,
+                        Node **copies, size_t *heapBytes)
+{
+    size_t itemBytes = 0;
+    for (Node *node = RBTreeFirst(tree); node != NULL; node = RBTreeNext(node))
+    {
+        itemBytes += getItemSize(tree, node->data);
+    }
+    // items are given room for the rounding of about two allocations each.
+    size_t blockSize = tree->size * ARENA_ROUND_UP(getNodeSize(tree)) +
+                       (relocateFunc == NULL ? 0 : itemBytes + tree->size * 2 * ARENA_ALIGNMENT);
+    Arena *arena = newArena(blockSize);
+    if (arena == NULL)
+    {
+        return NULL;
+    }
+    long unsigned i = 0;
+    for (Node *node = RBTreeFirst(tree); node != NULL; node = RBTreeNext(node), i++)
+    {
+        olds[i] = node;
+        copies[i] = (Node *) arenaAlloc(arena, getNodeSize(tree));
+        if (copies[i] == NULL ||
+            (relocateFunc == NULL && arenaContains(tree->arena, node->data)))
+        {
+            freeArena(&arena);
+            return NULL;
+        }
+        memcpy(copies[i], node, getNodeSize(tree));
+        if (relocateFunc != NULL)
+        {
+            copies[i]->data = relocateFunc(node->data, arena);
+            if (copies[i]->data == NULL)
+            {
+                freeArena(&arena);
+                return NULL;
+            }
+        }
+    }
+    *heapBytes = relocateFunc == NULL ? itemBytes : 0;
+    return arena;
+}
+
+/**
+ * @brief moves all the nodes of the tree, in ascending order of their items, into one fresh
+ * arena, and with a RelocateFunc the items too (the originals are freed with the tree's
+ * FreeFunc). the old nodes and the old arena are freed.
+ * @param tree: the tree to compact.
+ * @param relocateFunc: copies an item into the arena, NULL to move the nodes only.
+ * @return 0 on failure, other on success. (on failure the tree is unchanged).
+ */
+int compactRBTree(RBTree *tree, RelocateFunc relocateFunc)
+{
+    // the old nodes are rewritten - a tree with clones gets its own copies of them first.
+    if (tree == NULL || !ownAllNodes(tree))
+    {
+        return false;
+    }
+    if (tree->size == 0)
+    {
+        if (tree->family == NULL)
+        {
+            freeArena(&tree->arena);
+        }
+        return true;
+    }
+    long unsigned size = tree->size;
+    Node **olds = (Node **) malloc(2 * size * sizeof(Node *));
+    if (olds == NULL)
+    {
+        return false;
+    }
+    Node **copies = olds + size;
+    size_t heapBytes = 0;
+    Arena *arena = copyNodesToArena(tree, relocateFunc, olds, copies, &heapBytes);
+    if (arena == NULL || (tree->family != NULL && !addFamilyArena(tree->family, arena)))
+    {
+        freeArena(&arena);
+        free(olds);
+        return false;
+    }
+    // nothing can fail from here on. the item of every old node is replaced by its copy, so the
+    // pointers of the copies can be translated.
+    for (long unsigned i = 0; i < size; i++)
+    {
+        if (copies[i]->data != olds[i]->data)
+        {
+            releaseItem(tree, olds[i]->data);
+        }
+        olds[i]->data = copies[i];
+    }
+    for (long unsigned i = 0; i < size; i++)
+    {
+        Node *copy = copies[i];
+        copy->parent = copy->parent == NULL ? NULL : (Node *) copy->parent->data;
+        copy->left = copy->left == NULL ? NULL : (Node *) copy->left->data;
+        copy->right = copy->right == NULL ? NULL : (Node *) copy->right->data;
+    }
+    tree->root = (Node *) tree->root->data;
+    tree->finger = tree->finger == NULL ? NULL : (Node *) tree->finger->data;
+    for (long unsigned i = 0; i < size; i++)
+    {
+        if (!arenaContains(tree->arena, olds[i]))
+        {
+            free(olds[i]);
+        }
+    }
+    free(olds);
+    if (tree->family == NULL)
+    {
+        // in a family, the old arena may still hold nodes and items of clones.
+        freeArena(&tree->arena);
+    }
+    tree->arena = arena;
+    tree->heapBytes = heapBytes;
+    return true;
+}
+
+//-------------- copy-on-write clones. ----------------
+
+/**
+ * the number of holders of a node or of a payload. the holders of a node are the child pointers
+ * of nodes and the root pointers of trees that point to it, and the holders of a payload are the
+ * nodes that hold it.
+ */
+typedef struct Holders
+{
+    const void *key;
+    long unsigned holders;
+} Holders;
+
+/**
+ * the number of holders of the nodes (or of the payloads) that are held by more than one - an
+ * open-addressing table: a node or a payload that is not in it has a single holder. one that is
+ * left with a single holder leaves a tombstone in its slot, which the next growth of the table
+ * clears.
+ */
+typedef struct HolderTable
+{
+    Holders *slots;
+    long unsigned capacity, used, tombstones;
+} HolderTable;
+
+/**
+ * the state of all the trees cloned from one tree: the holders of their nodes and of their
+ * payloads, spare nodes for the copies of a write (so its fix-up cannot fail half way), and the
+ * arenas of the trees, that may hold nodes and payloads of several of them and are freed only
+ * with the family.
+ */
+struct CloneFamily
+{
+    long unsigned trees;
+    HolderTable nodes, payloads;
+    Node *spares;
+    long unsigned numSpares;
+    size_t spareSize;
+    Arena **arenas;
+    int numArenas;
+};
+
+/**
+ * @brief finds the slot of a node or a payload in a table of holders.
+ * @param slots: the slots of the table.
+ * @param capacity: the capacity of the table, a power of 2.
+ * @param key: the node or the payload.
+ * @return the slot of the key, or the slot where it should be added - the first tombstone on its
+ * way, or the empty slot that ends it.
+ */
+Holders *findHolders(Holders *slots, long unsigned capacity, const void *key)
+{
+    unsigned long long hash = (unsigned long long) (uintptr_t) key * 0x9E3779B97F4A7C15ULL;
+    long unsigned i = (long unsigned) (hash ^ (hash >> 32)) & (capacity - 1);
+    Holders *tombstone = NULL;
+    while (slots[i].key != NULL && slots[i].key != key)
+    {
+        if (slots[i].key == HOLDERS_TOMBSTONE && tombstone == NULL)
+        {
+            tombstone = &slots[i];
+        }
+        i = (i + 1) & (capacity - 1);
+    }
+    return slots[i].key == NULL && tombstone != NULL ? tombstone : &slots[i];
+}
+
+/**
+ * @brief makes room in a table of holders for more keys, so adding them cannot fail.
+ * @param table: the table.
+ * @param extra: number of keys that may be added.
+ * @return 0 on failure, other on success.
+ */
+int reserveHolders(HolderTable *table, long unsigned extra)
+{
+    long unsigned capacity = table->capacity == 0 ? INITIAL_HOLDERS_CAPACITY : table->capacity;
+    if (capacity == table->capacity &&
+        (table->used + table->tombstones + extra) * 4 <= capacity * 3)
+    {
+        return true;
+    }
+    // the table is rebuilt without its tombstones - it grows only if the live keys need it.
+    while ((table->used + extra) * 4 > capacity * 3)
+    {
+        capacity *= 2;
+    }
+    Holders *slots = (Holders *) calloc(capacity, sizeof(Holders));
+    if (slots == NULL)
+    {
+        return false;
+    }
+    for (long unsigned i = 0; i < table->capacity; i++)
+    {
+        if (table->slots[i].key != NULL && table->slots[i].key != HOLDERS_TOMBSTONE)
+        {
+            *findHolders(slots, capacity, table->slots[i].key) = table->slots[i];
+        }
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->capacity = capacity;
+    table->tombstones = 0;
+    return true;
+}
+
+/**
+ * @brief the number of holders of a node or a payload.
+ * @param table: the table.
+ * @param key: the node or the payload.
+ * @return the number of holders, 1 if it is not in the table.
+ */
+long unsigned countHolders(const HolderTable *table, const void *key)
+{
+    if (table->used == 0)
+    {
+        return 1;
+    }
+    const Holders *slot = findHolders(table->slots, table->capacity, key);
+    return slot->key == key ? slot->holders : 1;
+}
+
+/**
+ * @brief adds a holder to a node or a payload. there must be room for it (reserveHolders).
+ * @param table: the table.
+ * @param key: the node or the payload.
+ */
+void addHolder(HolderTable *table, const void *key)
+{
+    Holders *slot = findHolders(table->slots, table->capacity, key);
+    if (slot->key != key)
+    {
+        if (slot->key == HOLDERS_TOMBSTONE)
+        {
+            table->tombstones--;
+        }
+        slot->key = key;
+        slot->holders = 1;
+        table->used++;
+    }
+    slot->holders++;
+}
+
+/**
+ * @brief removes a holder from a node or a payload. one that is left with a single holder leaves
+ * the table - a single holder is what a missing slot means.
+ * @param table: the table.
+ * @param key: the node or the payload.
+ * @return true if it was the last holder - the key should be freed, false otherwise.
+ */
+int dropHolder(HolderTable *table, const void *key)
+{
+    if (table->used == 0)
+    {
+        return true;
+    }
+    Holders *slot = findHolders(table->slots, table->capacity, key);
+    if (slot->key != key)
+    {
+        return true;
+    }
+    if (--slot->holders == 1)
+    {
+        slot->key = HOLDERS_TOMBSTONE;
+        table->used--;
+        table->tombstones++;
+    }
+    return false;
+}
+
+/**
+ * @brief removes a holder from a payload of a family.
+ * @param family: the family.
+ * @param payload: the payload.
+ * @return true if it was the last holder - the payload should be freed, false otherwise.
+ */
+int dropPayloadHolder(CloneFamily *family, const void *payload)
+{
+    return dropHolder(&family->payloads, payload);
+}
+
+/**
+ * @brief checks whether a clone of the tree still holds one of its items. the node of the item
+ * must be the tree's own (ownPath) - a node shared with a clone holds its item once for both.
+ * @param tree: the tree.
+ * @param payload: an item of the tree.
+ * @return true if another tree of the family holds the item, false if only this tree does.
+ */
+int isItemHeldByClone(const RBTree *tree, const void *payload)
+{
+    return tree->family != NULL && countHolders(&tree->family->payloads, payload) > 1;
+}
+
+/**
+ * @brief hands an arena to a family, to be freed with it.
+ * @param family: the family.
+ * @param arena: the arena, may be NULL.
+ * @return 0 on failure, other on success.
+ */
+int addFamilyArena(CloneFamily *family, Arena *arena)
+{
+    for (int i = 0; i < family->numArenas; i++)
+    {
+        if (family->arenas[i] == arena)
+        {
+            return true;
+        }
+    }
+    if (arena == NULL)
+    {
+        return true;
+    }
+    Arena **arenas = (Arena **) realloc(family->arenas,
+                                         (family->numArenas + 1) * sizeof(Arena *));
+    if (arenas == NULL)
+    {
+        return false;
+    }
+    arenas[family->numArenas++] = arena;
+    family->arenas = arenas;
+    return true;
+}
+
+/**
+ * @brief frees the spare nodes of a family.
+ * @param family: the family.
+ */
+void freeSpareNodes(CloneFamily *family)
+{
+    while (family->spares != NULL)
+    {
+        Node *spare = family->spares;
+        family->spares = spare->left;
+        free(spare);
+    }
+    family->numSpares = 0;
+}
+
+/**
+ * @brief makes sure the tree can copy nodes it shares with its clones without failing - there are
+ * spare nodes for the copies, and room for their holders.
+ * @param tree: a tree of a family.
+ * @param count: number of nodes that may be copied.
+ * @return 0 on failure, other on success.
+ */
+int reserveNodeCopies(RBTree *tree, long unsigned count)
+{
+    CloneFamily *family = tree->family;
+    if (family->spareSize != getNodeSize(tree))
+    {
+        // an empty tree of the family may have been given another KeyPrefixFunc.
+        freeSpareNodes(family);
+        family->spareSize = getNodeSize(tree);
+    }
+    while (family->numSpares < count)
+    {
+        Node *spare = (Node *) malloc(family->spareSize);
+        if (spare == NULL)
+        {
+            return false;
+        }
+        spare->left = family->spares;
+        family->spares = spare;
+        family->numSpares++;
+    }
+    // a copy adds a holder to each of its children and to its payload.
+    return reserveHolders(&family->nodes, 2 * count) && reserveHolders(&family->payloads, count);
+}
+
+/**
+ * @brief gives the tree its own copy of a node before the node is written to, if another tree of
+ * its family holds it too. the node is reached through a pointer of the tree itself - its root
+ * pointer, or a child pointer of a node that is the tree's own already - so the nodes are copied
+ * top-down, and the copy replaces the node only in this tree. the parent of the node is set on
+ * the way, as the parents of nodes shared with clones are not kept. there must be room for the
+ * copy (reserveNodeCopies).
+ * @param tree: the tree.
+ * @param link: the pointer to the node.
+ * @param parent: the node the pointer is in, NULL for the root pointer.
+ * @return the node, now the tree's own. NULL if link points to no node.
+ */
+Node *ownNode(RBTree *tree, Node **link, Node *parent)
+{
+    Node *node = *link;
+    CloneFamily *family = tree->family;
+    if (family == NULL || node == NULL)
+    {
+        return node;
+    }
+    node->parent = parent;
+    if (countHolders(&family->nodes, node) == 1)
+    {
+        return node;
+    }
+    Node *copy = family->spares;
+    family->spares = copy->left;
+    family->numSpares--;
+    memcpy(copy, node, getNodeSize(tree));
+    if (copy->left != NULL)
+    {
+        addHolder(&family->nodes, copy->left);
+        copy->left->parent = copy;
+    }
+    if (copy->right != NULL)
+    {
+        addHolder(&family->nodes, copy->right);
+        copy->right->parent = copy;
+    }
+    addHolder(&family->payloads, copy->data);
+    dropHolder(&family->nodes, node);
+    *link = copy;
+    return copy;
+}
+
+/**
+ * @brief gives the tree its own copy of the sibling of a node, before the sibling is written to.
+ * @param tree: the tree.
+ * @param node: a node of the tree's own, not the root.
+ * @return the sibling, NULL if the node has none.
+ */
+Node *ownSibling(RBTree *tree, Node *node)
+{
+    Node *parent = node->parent;
+    return ownNode(tree, node == parent->left ? &parent->right : &parent->left, parent);
+}
+
+/**
+ * @brief gives a tree with clones its own copies of the nodes on the path from the root to the
+ * place of an item - and with removal, on to the node removeNode frees - and reserves copies
+ * for the nodes the fix-up may change off the path (the siblings and nephews of the path, at most
+ * a few per level).
+ * @param tree: a tree of a family.
+ * @param data: the item.
+ * @param prefix: the key prefix of the item.
+ * @param removal: true if the node of the item is going to be removed.
+ * @param existing: set to the node with an item equal to data, NULL if there is none.
+ * @param parent, comparison: set as in findPlace.
+ * @return 0 on failure (the items of the tree are unchanged), other on success.
+ */
+int ownPath(RBTree *tree, const void *data, unsigned long long prefix, int removal,
+            Node **existing, Node **parent, int *comparison)
+{
+    Node **link = &tree->root;
+    size_t lcpLow = 0, lcpHigh = 0;
+    long unsigned depth = 0;
+    *existing = NULL;
+    *parent = NULL;
+    *comparison = 0;
+    while (*link != NULL)
+    {
+        if (!reserveNodeCopies(tree, 1))
+        {
+            return false;
+        }
+        Node *node = ownNode(tree, link, *parent);
+        depth++;
+        *comparison = compareOnDescent(tree, data, prefix, node, &lcpLow, &lcpHigh);
+        if (*comparison == 0)
+        {
+            *existing = node;
+            break;
+        }
+        *parent = node;
+        link = *comparison < 0 ? &node->left : &node->right;
+    }
+    if (removal && *existing != NULL && (*existing)->left != NULL && (*existing)->right != NULL)
+    {
+        // the successor's node is the one that is unlinked.
+        Node *node = *existing;
+        for (link = &node->right; *link != NULL; link = &node->left, depth++)
+        {
+            if (!reserveNodeCopies(tree, 1))
+            {
+                return false;
+            }
+            node = ownNode(tree, link, node);
+        }
+    }
+    return reserveNodeCopies(tree, 3 * depth + 8);
+}
+
+/**
+ * @brief finds the node of an item before it is written to - in a tree with clones, gives the
+ * tree its own copies of the path to it first (ownPath).
+ * @param tree: the tree.
+ * @param data: the item.
+ * @param removal: true if the node is going to be removed.
+ * @return the node, NULL if the item is not in the tree, or on failure.
+ */
+Node *findNodeToWrite(RBTree *tree, const void *data, int removal)
+{
+    if (tree->family == NULL)
+    {
+        return findNode(tree, data);
+    }
+    if (data == NULL || tree->compFunc == NULL)
+    {
+        return NULL;
+    }
+    Node *existing, *parent;
+    int comparison;
+    if (!ownPath(tree, data, getKeyPrefix(tree, data), removal, &existing, &parent, &comparison))
+    {
+        return NULL;
+    }
+    return existing;
+}
+
+/**
+ * @brief gives the tree its own copies of all its nodes, before all of them are rewritten (a
+ * rebuild or a compaction - O(n) anyway). the nodes are walked along their parents, as in
+ * RBTreeHeight, which ownNode sets on the way down.
+ * @param tree: the tree.
+ * @return 0 on failure (the items of the tree are unchanged), other on success.
+ */
+int ownAllNodes(RBTree *tree)
+{
+    if (tree->family == NULL || tree->root == NULL)
+    {
+        return true;
+    }
+    if (!reserveNodeCopies(tree, 1))
+    {
+        return false;
+    }
+    Node *node = ownNode(tree, &tree->root, NULL), *previous = NULL;
+    while (node != NULL)
+    {
+        Node **link = NULL;
+        if (previous == node->parent)
+        {
+            link = node->left != NULL ? &node->left : node->right != NULL ? &node->right : NULL;
+        }
+        else if (previous == node->left && node->right != NULL)
+        {
+            link = &node->right;
+        }
+        previous = node;
+        if (link == NULL)
+        {
+            node = node->parent;
+            continue;
+        }
+        if (!reserveNodeCopies(tree, 1))
+        {
+            return false;
+        }
+        node = ownNode(tree, link, node);
+    }
+    return true;
+}
+
+/**
+ * @brief lets go of the tree's pointer to a node, as the tree is freed. a node that another tree
+ * of the family holds too is left to it, with its whole sub-tree.
+ * @param tree: the tree.
+ * @param node: the node, may be NULL.
+ * @param released: the size of the sub-tree of a node left to another tree is added to it.
+ * @return the node if the tree held it alone (it is the tree's to free), NULL otherwise.
+ */
+Node *releaseLink(RBTree *tree, Node *node, long unsigned *released)
+{
+    if (node == NULL || tree->family == NULL || dropHolder(&tree->family->nodes, node))
+    {
+        return node;
+    }
+    *released += node->subtreeSize;
+    return NULL;
+}
+
+/**
+ * @brief frees the arena of the tree, or - if it has clones - leaves their family, and frees the
+ * family (with all its arenas) if it was the last tree in it.
+ * @param tree: the tree.
+ */
+void leaveCloneFamily(RBTree *tree)
+{
+    CloneFamily *family = tree->family;
+    if (family == NULL)
+    {
+        freeArena(&tree->arena);
+        return;
+    }
+    tree->family = NULL;
+    tree->arena = NULL;
+    if (--family->trees > 0)
+    {
+        return;
+    }
+    for (int i = 0; i < family->numArenas; i++)
+    {
+        freeArena(&family->arenas[i]);
+    }
+    freeSpareNodes(family);
+    free(family->arenas);
+    free(family->nodes.slots);
+    free(family->payloads.slots);
+    free(family);
+}
+
+/**
+ * @brief clone the tree in O(1) - the clone holds the root of the tree, so it shares all the nodes
+ * and the items of the tree, and every write to either of them copies only the nodes it changes.
+ * @param tree: the tree to clone.
+ * @return the clone, NULL on failure.
+ */
+RBTree *RBTreeClone(RBTree *tree)
+{
+    if (tree == NULL)
+    {
+        return NULL;
+    }
+    RBTree *clone = (RBTree *) malloc(sizeof(RBTree));
+    if (clone == NULL)
+    {
+        return NULL;
+    }
+    if (tree->family == NULL)
+    {
+        CloneFamily *family = (CloneFamily *) calloc(1, sizeof(CloneFamily));
+        if (family == NULL || !addFamilyArena(family, tree->arena))
+        {
+            free(family);
+            free(clone);
+            return NULL;
+        }
+        family->trees = 1;
+        tree->family = family;
+    }
+    if (tree->root != NULL)
+    {
+        if (!reserveHolders(&tree->family->nodes, 1))
+        {
+            free(clone);
+            return NULL;
+        }
+        addHolder(&tree->family->nodes, tree->root);
+    }
+    // the finger must be a node of the tree's own - a node shared with a clone may be copied.
+    tree->finger = NULL;
+    *clone = *tree;
+    tree->family->trees++;
+    return clone;
+}
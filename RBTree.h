@@ -1,6 +1,8 @@
 #ifndef RBTREE_RBTREE_H
 #define RBTREE_RBTREE_H
 
+#include "Arena.h"
+
 // a color of a Node.
 typedef enum Color
 {
@@ -23,29 +25,110 @@ typedef int (*CompareFunc)(const void *a, const void *b);
 typedef int (*forEachFunc)(const void *object, void *args);
 
 /**
- * a function to free a data item
+ * a function to free a data item. a tree with a NULL FreeFunc borrows its items - it never frees
+ * them (for example items that live in an arena or in a mapped file).
  * @object: a pointer to an item of the tree.
  */
 typedef void (*FreeFunc)(void *data);
 
+/**
+ * a function that maps an item to an order-preserving key prefix: if prefix(a) < prefix(b) then
+ * a < b. equal prefixes say nothing - the CompareFunc decides.
+ * @object: a pointer to an item of the tree.
+ * @return: the prefix of the item.
+ */
+typedef unsigned long long (*KeyPrefixFunc)(const void *data);
+
+/**
+ * a CompareFunc that can skip a common prefix of the two items that is already known - the
+ * bytes (or elements) of a string-like item the search compared on the way down.
+ * @a, @b: two items.
+ * @skip: a and b are known to be equal in their first skip bytes, which need no comparison.
+ * @lcp: set to the length of the common prefix of a and b - or to any smaller length, down to
+ * skip.
+ * @return: the same as the tree's CompareFunc.
+ */
+typedef int (*LcpCompareFunc)(const void *a, const void *b, size_t skip, size_t *lcp);
+
+/**
+ * a function that tells how much memory an item holds.
+ * @object: a pointer to an item of the tree.
+ * @return: number of bytes of the item, including everything it points to and owns.
+ */
+typedef size_t (*SizeFunc)(const void *data);
+
+/**
+ * a function that copies an item, with everything it owns, into memory allocated from an arena.
+ * @object: a pointer to an item of the tree.
+ * @arena: the arena to allocate the copy from (only from it - the copy is never freed on its own).
+ * @return: pointer to the copy, NULL on failure.
+ */
+typedef void *(*RelocateFunc)(const void *data, Arena *arena);
+
+/**
+ * the ways a tree keeps itself balanced (newRBTreeWithPolicy).
+ * BALANCE_RED_BLACK: a red-black tree - at most 2 rotations per insert, 3 per delete.
+ * BALANCE_AVL: an AVL tree - the heights of the children of every node differ by at most 1, so it
+ * is lower (faster lookups) at the cost of more rotations on updates.
+ * BALANCE_TREAP: a treap - every node has a random priority no lower than its children's, so it is
+ * balanced in expectation, but has no worst case bound. it makes no rotations on delete, and about
+ * 2 per insert (more than the others).
+ */
+typedef enum BalancePolicy
+{
+	BALANCE_RED_BLACK, BALANCE_AVL, BALANCE_TREAP
+} BalancePolicy;
+
 /*
- * a node of the tree.
+ * a node of the tree. rank is the height of the node in an AVL tree and its priority in a treap.
+ * the nodes of a tree with a KeyPrefixFunc are PrefixNodes, so the nodes of the other trees do not
+ * carry a prefix.
  */
 typedef struct Node
 {
 	struct Node *parent, *left, *right;
 	Color color;
+	int rank;
 	void *data;
+	long unsigned count;
+	long unsigned subtreeSize;
 } Node;
 
+/*
+ * a node of a tree with a KeyPrefixFunc - the key prefix of its item follows the node.
+ */
+typedef struct PrefixNode
+{
+	Node node;
+	unsigned long long keyPrefix;
+} PrefixNode;
+
+// the key prefix of a node of a tree with a KeyPrefixFunc.
+#define NODE_KEY_PREFIX(node) (((PrefixNode *) (node))->keyPrefix)
+
 /**
- * represents the tree
+ * the state of all the trees cloned from one tree (RBTreeClone).
+ */
+typedef struct CloneFamily CloneFamily;
+
+/**
+ * represents the tree. rotations counts the rotations the tree made since it was created.
  */
 typedef struct RBTree
 {
 	Node *root;
 	CompareFunc compFunc;
 	FreeFunc freeFunc;
+	KeyPrefixFunc prefixFunc;
+	LcpCompareFunc lcpCompFunc;
+	int multiset;
+	Node *finger;
+	SizeFunc sizeFunc;
+	Arena *arena;
+	size_t heapBytes;
+	CloneFamily *family;
+	BalancePolicy policy;
+	long unsigned rotations;
 	long unsigned size;
 } RBTree;
 
@@ -55,22 +138,110 @@ typedef struct RBTree
  */
 RBTree *newRBTree(CompareFunc compFunc, FreeFunc freeFunc); // implement it in RBTree.c
 
+/**
+ * constructs a new tree that keeps itself balanced by the given policy. all the functions of this
+ * file work on it the same way, whatever the policy is.
+ * @param compFunc: a function to compare two items.
+ * @param freeFunc: a function to free an item.
+ * @param policy: the balancing policy.
+ * @return a new tree. if creation failed, returns NULL.
+ */
+RBTree *newRBTreeWithPolicy(CompareFunc compFunc, FreeFunc freeFunc, BalancePolicy policy);
+
+/**
+ * sets a KeyPrefixFunc to the tree. the prefix of every item is computed once, when it is
+ * inserted, and kept in its node - comparisons call the CompareFunc only when the prefixes tie.
+ * the nodes of the tree grow by the 8 bytes of the prefix (PrefixNode) - trees without a
+ * KeyPrefixFunc do not pay for it.
+ * @param tree: an empty tree.
+ * @param prefixFunc: the prefix function of the tree's items (NULL to compare full items only).
+ * @return: 0 on failure, other on success. (if the tree is not empty - failure).
+ */
+int setRBTreeKeyPrefix(RBTree *tree, KeyPrefixFunc prefixFunc);
+
+/**
+ * sets an LcpCompareFunc to the tree, used instead of the CompareFunc where a search descends
+ * from the root (find, contains, insert): a search of an item that shares a long prefix with
+ * many items of the tree does not compare the whole prefix again at every level. it pays off when
+ * the items share prefixes of hundreds of bytes or more - on short items the CompareFunc alone is
+ * a little faster.
+ * @param tree: the tree.
+ * @param lcpCompFunc: a function that orders the items exactly as the tree's CompareFunc (NULL to
+ * compare with the CompareFunc only).
+ * @return: 0 on failure, other on success.
+ */
+int setRBTreeLcpCompare(RBTree *tree, LcpCompareFunc lcpCompFunc);
+
+/**
+ * turns the tree into a multiset (or back into a set). in a multiset, inserting an item that is
+ * already in the tree counts it again in the node of the equal item (one descent), and the
+ * inserted duplicate is freed with the tree's FreeFunc. size counts distinct items.
+ * @param tree: an empty tree.
+ * @param multiset: other than 0 for a multiset, 0 for a set.
+ * @return: 0 on failure, other on success. (if the tree is not empty - failure).
+ */
+int setRBTreeMultiset(RBTree *tree, int multiset);
+
+/**
+ * sets a SizeFunc to the tree, so RBTreeMemoryUsage counts the memory of the items too.
+ * @param tree: an empty tree.
+ * @param sizeFunc: the size function of the tree's items (NULL to count the nodes only).
+ * @return: 0 on failure, other on success. (if the tree is not empty - failure).
+ */
+int setRBTreeSizeFunc(RBTree *tree, SizeFunc sizeFunc);
+
 /**
  * add an item to the tree
  * @param tree: the tree to add an item to.
  * @param data: item to add to the tree.
- * @return: 0 on failure, other on success. (if the item is already in the tree - failure).
+ * @return: 0 on failure, other on success. (if the item is already in the tree - failure, unless
+ * the tree is a multiset).
  */
 int insertToRBTree(RBTree *tree, void *data); // implement it in RBTree.c
 
 /**
- * remove an item from the tree
+ * remove an item from the tree (all its occurrences, in a multiset)
  * @param tree: the tree to remove an item from.
  * @param data: item to remove from the tree.
  * @return: 0 on failure, other on success. (if data is not in the tree - failure).
  */
 int deleteFromRBTree(RBTree *tree, void *data); // implement it in RBTree.c
 
+/**
+ * add an item to the tree, searching for its place from a node that is expected to be near it
+ * (climbing up from the hint only as far as needed, then down) instead of from the root.
+ * insertToRBTree itself first tries the gap next to the last inserted node (tree->finger), so
+ * sorted inserts take O(1) comparisons. for nearly sorted streams, pass tree->finger as the hint.
+ * a tree with clones (RBTreeClone) searches from the root, and ignores the hint and the finger.
+ * @param tree: the tree to add an item to.
+ * @param data: item to add to the tree.
+ * @param hint: a node of the tree (for example tree->finger), NULL to search from the root.
+ * @return: 0 on failure, other on success. (same as insertToRBTree).
+ */
+int insertToRBTreeWithHint(RBTree *tree, void *data, Node *hint);
+
+/**
+ * remove one occurrence of an item from a multiset - decrements its count, and deletes it (as
+ * deleteFromRBTree) when the count drops to 0. in a set, same as deleteFromRBTree.
+ * @param tree: the tree to remove an item from.
+ * @param data: item to remove from the tree.
+ * @return: 0 on failure, other on success. (if data is not in the tree - failure).
+ */
+int decrementInRBTree(RBTree *tree, void *data);
+
+/**
+ * remove an item from the tree without freeing it - the ownership of the item moves to the caller.
+ * in a tree cloned with RBTreeClone (or cloned from), an item that another tree of the family
+ * still holds is not the tree's to hand over: it is not removed, and NULL is returned while
+ * RBTreeContains still finds it. deleteFromRBTree removes such an item, and leaves it to the
+ * clones.
+ * @param tree: the tree to remove an item from.
+ * @param data: item equal to the one to remove.
+ * @return: the removed item as it was stored in the tree, NULL if data is not in the tree or
+ * another tree of its family holds it.
+ */
+void *removeFromRBTree(RBTree *tree, const void *data);
+
 /**
  * check whether the tree RBTreeContains this item.
  * @param tree: the tree to add an item to.
@@ -79,8 +250,90 @@ int deleteFromRBTree(RBTree *tree, void *data); // implement it in RBTree.c
  */
 int RBTreeContains(const RBTree *tree, const void *data); // implement it in RBTree.c
 
+/**
+ * check which of the items are in the tree. the searches walk down the tree together, prefetching
+ * their next nodes, so their cache misses overlap - much faster than one RBTreeContains per item
+ * on a tree larger than the cache.
+ * @param tree: the tree to search in.
+ * @param items: the items to check.
+ * @param numItems: number of items.
+ * @param results: array of numItems, results[i] is set to 0 if items[i] is not in the tree, 1 if
+ * it is.
+ * @return: 0 on failure, other on success.
+ */
+int RBTreeContainsBatch(const RBTree *tree, const void *const *items, int numItems, int *results);
+
+/**
+ * count the items of the tree in a range, in O(log n) - every node knows the size of its sub-tree.
+ * in a multiset, every item is counted once.
+ * @param tree: the tree to count in.
+ * @param low: the smallest item of the range (inclusive), NULL for no lower bound.
+ * @param high: the largest item of the range (inclusive), NULL for no upper bound.
+ * @return: number of items of the tree in the range.
+ */
+long unsigned RBTreeCountRange(const RBTree *tree, const void *low, const void *high);
+
+/**
+ * the rank of an item - the number of items of the tree that are smaller than it, in O(log n).
+ * @param tree: the tree.
+ * @param data: the item (it does not have to be in the tree).
+ * @return: the rank of the item.
+ */
+long unsigned RBTreeRank(const RBTree *tree, const void *data);
+
+/**
+ * find the node of the item of a given rank, in O(log n). with RBTreeNext, walks the items from
+ * any position.
+ * @param tree: the tree.
+ * @param rank: the rank - 0 for the smallest item.
+ * @return: the node, NULL if rank is not smaller than the size of the tree.
+ */
+Node *RBTreeSelect(const RBTree *tree, long unsigned rank);
+
+/**
+ * remove all the items of the tree in a range (all their occurrences, in a multiset), and free
+ * them with the tree's FreeFunc (if it has one) once the tree is rebalanced. a range of most of
+ * the tree is removed by rebuilding the tree from the items that are left, in O(n).
+ * @param tree: the tree to remove the items from.
+ * @param low: the smallest item of the range (inclusive), NULL for no lower bound.
+ * @param high: the largest item of the range (inclusive), NULL for no upper bound.
+ * @return: number of items removed.
+ */
+long unsigned RBTreeDeleteRange(RBTree *tree, const void *low, const void *high);
+
+/**
+ * count the occurrences of an item in the tree.
+ * @param tree: the tree to search in.
+ * @param data: item to count.
+ * @return: number of times the item was inserted into a multiset (and not removed), 0 or 1 in a
+ * set.
+ */
+long unsigned RBTreeCount(const RBTree *tree, const void *data);
+
+/**
+ * find the item of the tree that is equal to the given one.
+ * @param tree: the tree to search in.
+ * @param data: item to search.
+ * @return: the item as it is stored in the tree (borrowed - owned by the tree unless it has a NULL
+ * FreeFunc), NULL if it is not in the tree.
+ */
+const void *RBTreeFind(const RBTree *tree, const void *data);
+
 
 
+/**
+ * @param tree: the tree to iterate.
+ * @return: the node of the smallest item in the tree, NULL if the tree is empty. together with
+ * RBTreeNext, walks the tree in ascending order.
+ */
+Node *RBTreeFirst(const RBTree *tree);
+
+/**
+ * @param node: a node of a tree.
+ * @return: the node of the next item in ascending order, NULL if node holds the largest item.
+ */
+Node *RBTreeNext(const Node *node);
+
 /**
  * Activate a function on each item of the tree. the order is an ascending order. if one of the activations of the
  * function returns 0, the process stops.
@@ -92,10 +345,75 @@ int RBTreeContains(const RBTree *tree, const void *data); // implement it in RBT
 int forEachRBTree(const RBTree *tree, forEachFunc func, void *args); // implement it in RBTree.c
 
 /**
- * free all memory of the data structure.
+ * @param tree: the tree.
+ * @return: number of nodes on the longest path from the root down (0 for an empty tree).
+ */
+int RBTreeHeight(const RBTree *tree);
+
+/**
+ * @param tree: the tree.
+ * @return: number of bytes the tree holds - the tree, its nodes, its items (as told by its
+ * SizeFunc) and the arena of the last compaction.
+ */
+size_t RBTreeMemoryUsage(const RBTree *tree);
+
+/**
+ * moves all the nodes of the tree, in ascending order of their items, into one fresh arena, so a
+ * tree that lived through much churn becomes contiguous again and its scans walk memory forward.
+ * with a RelocateFunc the items are moved too: they are replaced by their copies (the originals
+ * are freed with the tree's FreeFunc, if it has one), so pointers to them become invalid. items
+ * that live in the arena are never freed on their own - an item removed by removeFromRBTree stays
+ * valid only until the next compaction or until the tree is freed.
+ * @param tree: the tree to compact.
+ * @param relocateFunc: copies an item into the arena, NULL to move the nodes only (failure if
+ * the items were moved by an earlier compaction).
+ * @return: 0 on failure, other on success. (on failure the tree is unchanged).
+ */
+int compactRBTree(RBTree *tree, RelocateFunc relocateFunc);
+
+/**
+ * clone the tree in O(1): the clone shares the nodes and the items of the tree. a write to the
+ * tree or to a clone copies only the nodes it changes - the path from the root to the item, and
+ * the few nodes next to it that the rebalancing changes - so it takes O(log n) time and memory
+ * whatever the size of the tree (a range rebuild and a compaction copy all the nodes). the items
+ * stay shared - every item is freed (with the FreeFunc) only when no tree of the family holds it
+ * anymore. a node shared by several trees has another parent in each, so the parents are set by
+ * the descents (RBTreeFirst, RBTreeSelect, RBTreeNext): a node of a tree with clones may be
+ * passed to RBTreeNext only until another tree of its family is used. a tree and its clones may
+ * not be used concurrently, even for reads.
+ * @param tree: the tree to clone.
+ * @return: the clone, to be freed with freeRBTree. NULL on failure.
+ */
+RBTree *RBTreeClone(RBTree *tree);
+
+/**
+ * free all memory of the data structure. the items are freed only if the tree has a FreeFunc.
  * @param tree: pointer to the tree to free.
  */
 void freeRBTree(RBTree **tree); // implement it in RBTree.c
 
+/**
+ * free a bounded part of the tree, so a huge tree can be freed in small time slices. after the
+ * first call the tree is being torn down - it may only be passed to this function again (or to
+ * freeRBTree).
+ * @param tree: pointer to the tree to free. set to NULL once it is freed completely.
+ * @param budget: maximal number of steps in this call (each step is a rotation or one free).
+ * @return: number of nodes left to free. 0 means the tree is freed.
+ */
+long unsigned freeRBTreeStep(RBTree **tree, long unsigned budget);
+
+/**
+ * hand the tree to a background thread that frees it, so the caller does not wait for a huge
+ * tree to be torn down. the tree's FreeFunc is called on that thread. a tree that has clones is
+ * freed on the calling thread.
+ * @param tree: pointer to the tree to free. set to NULL.
+ */
+void freeRBTreeInBackground(RBTree **tree);
+
+/**
+ * wait until the background thread freed all the trees handed to freeRBTreeInBackground.
+ */
+void waitForRBTreeReclaimer(void);
+
 
 #endif //RBTREE_RBTREE_H
\ No newline at end of file
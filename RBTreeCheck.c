@@ -0,0 +1,1147 @@
+/**
+ * @file RBTreeCheck.c
+ * @date 18 october 2026
+ * @brief an invariant checker for RBTrees, a seeded generator of workloads, a runner that
+ * compares a tree with a reference sorted array while timing it, and benchmarks of the balancing
+ * policies, of the key prefixes, of the scaling of the SkipList and of the KD-tree of vectors.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include "RBTreeCheck.h"
+#include "SkipList.h"
+#include "Structs.h"
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#endif
+#define INITIAL_STACK_CAPACITY 64
+#define PERCENT 100
+
+//-------------- invariant checker. ----------------
+
+/**
+ * a node waiting to be checked, with the items its sub-tree must be between (NULL - no bound), and
+ * the number of black nodes above it.
+ */
+typedef struct CheckFrame
+{
+    const Node *node;
+    const Node *low, *high;
+    long unsigned blackDepth;
+} CheckFrame;
+
+/**
+ * @brief checks the balance of a node by the policy of an AVL tree or a treap.
+ * @param tree: the tree.
+ * @param node: the node.
+ * @return other than 0 if the node is balanced, 0 if not.
+ */
+int isBalancedNode(const RBTree *tree, const Node *node)
+{
+    int left = node->left == NULL ? 0 : node->left->rank;
+    int right = node->right == NULL ? 0 : node->right->rank;
+    if (tree->policy == BALANCE_AVL)
+    {
+        return node->rank == (left > right ? left : right) + 1 && left - right <= 1 &&
+               right - left <= 1;
+    }
+    return left <= node->rank && right <= node->rank;
+}
+
+/**
+ * @brief checks the invariants of a single node, except the black height.
+ * @param tree: the tree.
+ * @param frame: the node and its bounds.
+ * @return the RBTreeCheckFlags of the broken invariants.
+ */
+int checkNode(const RBTree *tree, const CheckFrame *frame)
+{
+    const Node *node = frame->node;
+    int broken = 0;
+    if ((frame->low != NULL && tree->compFunc(frame->low->data, node->data) >= 0) ||
+        (frame->high != NULL && tree->compFunc(node->data, frame->high->data) >= 0))
+    {
+        broken |= RBTREE_CHECK_ORDER;
+    }
+    if (tree->policy != BALANCE_RED_BLACK)
+    {
+        broken |= isBalancedNode(tree, node) ? 0 : RBTREE_CHECK_BALANCE;
+    }
+    else if (node->color == RED && ((node->left != NULL && node->left->color == RED) ||
+                                    (node->right != NULL && node->right->color == RED)))
+    {
+        broken |= RBTREE_CHECK_RED_RED;
+    }
+    // the nodes of a tree with clones have their parents set by the descents only.
+    if (tree->family == NULL && ((node->left != NULL && node->left->parent != node) ||
+                                 (node->right != NULL && node->right->parent != node)))
+    {
+        broken |= RBTREE_CHECK_PARENTS;
+    }
+    if ((tree->prefixFunc != NULL && tree->prefixFunc(node->data) != NODE_KEY_PREFIX(node)) ||
+        node->count == 0 || (!tree->multiset && node->count != 1) ||
+        node->subtreeSize != (node->left == NULL ? 0 : node->left->subtreeSize) +
+                             (node->right == NULL ? 0 : node->right->subtreeSize) + 1)
+    {
+        broken |= RBTREE_CHECK_NODES;
+    }
+    return broken;
+}
+
+/**
+ * @brief pushes a frame to the stack of the check, growing it if needed.
+ * @param stack: pointer to the stack.
+ * @param size: pointer to the number of frames in the stack.
+ * @param capacity: pointer to the capacity of the stack.
+ * @param frame: the frame to push.
+ * @return 0 on failure, other on success.
+ */
+int pushCheckFrame(CheckFrame **stack, long unsigned *size, long unsigned *capacity,
+                   CheckFrame frame)
+{
+    if (*size == *capacity)
+    {
+        CheckFrame *grown = (CheckFrame *) realloc(*stack, 2 * (*capacity) * sizeof(CheckFrame));
+        if (grown == NULL)
+        {
+            return false;
+        }
+        *stack = grown;
+        *capacity *= 2;
+    }
+    (*stack)[(*size)++] = frame;
+    return true;
+}
+
+/**
+ * @brief checks all the invariants of a tree, without recursion.
+ * @param tree: the tree to check.
+ * @return 0 if the tree is valid, otherwise the RBTreeCheckFlags of the broken invariants.
+ */
+int checkRBTree(const RBTree *tree)
+{
+    if (tree == NULL)
+    {
+        return 0;
+    }
+    int broken = 0;
+    if (tree->root != NULL && ((tree->policy == BALANCE_RED_BLACK && tree->root->color != BLACK) ||
+                               (tree->family == NULL && tree->root->parent != NULL)))
+    {
+        broken |= RBTREE_CHECK_ROOT_COLOR;
+    }
+    long unsigned capacity = INITIAL_STACK_CAPACITY, size = 0, count = 0;
+    CheckFrame *stack = (CheckFrame *) malloc(capacity * sizeof(CheckFrame));
+    if (stack == NULL)
+    {
+        return broken | RBTREE_CHECK_MEMORY;
+    }
+    stack[size++] = (CheckFrame) {tree->root, NULL, NULL, 0};
+    long unsigned blackHeight = 0;
+    int sawLeaf = false, sawFinger = tree->finger == NULL;
+    while (size > 0)
+    {
+        CheckFrame frame = stack[--size];
+        if (frame.node == NULL)
+        {
+            if (sawLeaf && frame.blackDepth != blackHeight && tree->policy == BALANCE_RED_BLACK)
+            {
+                broken |= RBTREE_CHECK_BLACK_HEIGHT;
+            }
+            sawLeaf = true;
+            blackHeight = frame.blackDepth;
+            continue;
+        }
+        if (++count > tree->size)
+        {
+            // too many nodes - and maybe a cycle, so stop here.
+            broken |= RBTREE_CHECK_SIZE;
+            break;
+        }
+        sawFinger = sawFinger || frame.node == tree->finger;
+        broken |= checkNode(tree, &frame);
+        long unsigned depth = frame.blackDepth + (frame.node->color == BLACK);
+        if (!pushCheckFrame(&stack, &size, &capacity,
+                            (CheckFrame) {frame.node->right, frame.node, frame.high, depth}) ||
+            !pushCheckFrame(&stack, &size, &capacity,
+                            (CheckFrame) {frame.node->left, frame.low, frame.node, depth}))
+        {
+            broken |= RBTREE_CHECK_MEMORY;
+            break;
+        }
+    }
+    free(stack);
+    if (count != tree->size)
+    {
+        broken |= RBTREE_CHECK_SIZE;
+    }
+    if (!sawFinger && !(broken & (RBTREE_CHECK_SIZE | RBTREE_CHECK_MEMORY)))
+    {
+        broken |= RBTREE_CHECK_NODES;
+    }
+    return broken;
+}
+
+//-------------- workloads. ----------------
+
+/**
+ * @brief the next number of a splitmix64 generator - fast, and the same on every platform.
+ * @param state: the state of the generator.
+ * @return a random number.
+ */
+unsigned long long nextRandom(unsigned long long *state)
+{
+    unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief generates a workload.
+ * @param seed: the seed of the generator.
+ * @param numOps: number of operations.
+ * @param keyRange: the keys are drawn uniformly from 0 .. keyRange - 1.
+ * @param readPercent: percent of contains operations (0 - 100).
+ * @return a new workload. if creation failed, returns NULL.
+ */
+Workload *newWorkload(unsigned long long seed, long unsigned numOps, long keyRange,
+                      int readPercent)
+{
+    if (keyRange <= 0 || readPercent < 0 || readPercent > PERCENT)
+    {
+        return NULL;
+    }
+    Workload *workload = (Workload *) calloc(1, sizeof(Workload));
+    if (workload == NULL)
+    {
+        return NULL;
+    }
+    workload->ops = (WorkloadOp *) malloc((numOps > 0 ? numOps : 1) * sizeof(WorkloadOp));
+    if (workload->ops == NULL)
+    {
+        free(workload);
+        return NULL;
+    }
+    workload->size = numOps;
+    workload->keyRange = keyRange;
+    unsigned long long state = seed;
+    for (long unsigned i = 0; i < numOps; i++)
+    {
+        unsigned long long random = nextRandom(&state);
+        if ((int) (random % PERCENT) < readPercent)
+        {
+            workload->ops[i].type = WORKLOAD_CONTAINS;
+        }
+        else
+        {
+            workload->ops[i].type = (random >> 32) & 1 ? WORKLOAD_INSERT : WORKLOAD_DELETE;
+        }
+        workload->ops[i].key = (long) (nextRandom(&state) % (unsigned long long) keyRange);
+    }
+    return workload;
+}
+
+/**
+ * @brief free the workload.
+ * @param workload: pointer to the workload to free.
+ */
+void freeWorkload(Workload **workload)
+{
+    if (workload == NULL || *workload == NULL)
+    {
+        return;
+    }
+    free((*workload)->ops);
+    free(*workload);
+    *workload = NULL;
+}
+
+//-------------- differential runner. ----------------
+
+/**
+ * @brief CompFunc for the keys of a workload.
+ * @param a: pointer to long.
+ * @param b: pointer to long.
+ * @return equal to 0 iff a == b. lower than 0 if a < b. Greater than 0 iff b < a.
+ */
+int compareKeys(const void *a, const void *b)
+{
+    long first = *(const long *) a, second = *(const long *) b;
+    return (first > second) - (first < second);
+}
+
+/**
+ * @brief seconds of a monotonic clock.
+ * @return the time.
+ */
+double monotonicSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+/**
+ * @brief runs the operations of a workload on a tree, timing the operations only.
+ * @param workload: the workload.
+ * @param tree: a tree of keys.
+ * @param keys: the keys 0 .. keyRange - 1 (the tree borrows its items from here).
+ * @param checkEvery: check the invariants after every this many operations (0 - never).
+ * @param answers: set to the result of every operation.
+ * @param result: the time and the broken invariants are set here.
+ */
+void runOnTree(const Workload *workload, RBTree *tree, long *keys, long unsigned checkEvery,
+               char *answers, WorkloadResult *result)
+{
+    long unsigned segment = checkEvery == 0 ? workload->size : checkEvery;
+    for (long unsigned start = 0; start < workload->size; start += segment)
+    {
+        long unsigned end = start + segment < workload->size ? start + segment : workload->size;
+        double begin = monotonicSeconds();
+        for (long unsigned i = start; i < end; i++)
+        {
+            long *key = &keys[workload->ops[i].key];
+            switch (workload->ops[i].type)
+            {
+                case WORKLOAD_INSERT:
+                    answers[i] = insertToRBTree(tree, key) != 0;
+                    break;
+                case WORKLOAD_DELETE:
+                    answers[i] = deleteFromRBTree(tree, key) != 0;
+                    break;
+                default:
+                    answers[i] = RBTreeContains(tree, key) != 0;
+                    break;
+            }
+        }
+        result->seconds += monotonicSeconds() - begin;
+        if (checkEvery != 0)
+        {
+            result->invariants |= checkRBTree(tree);
+        }
+    }
+}
+
+/**
+ * @brief finds a key in a sorted array.
+ * @param sorted: the array.
+ * @param size: number of keys in the array.
+ * @param key: the key.
+ * @return the index of the key, or where it should be inserted.
+ */
+long unsigned lowerBound(const long *sorted, long unsigned size, long key)
+{
+    long unsigned low = 0, high = size;
+    while (low < high)
+    {
+        long unsigned middle = low + (high - low) / 2;
+        if (sorted[middle] < key)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/**
+ * @brief replays a workload on a sorted array, and compares the results with the tree's answers.
+ * @param workload: the workload.
+ * @param sorted: an array of keyRange longs, set to the final keys.
+ * @param answers: the results of the tree.
+ * @param result: the mismatches are set here.
+ * @return number of keys in sorted at the end.
+ */
+long unsigned runOnReference(const Workload *workload, long *sorted, const char *answers,
+                             WorkloadResult *result)
+{
+    long unsigned size = 0;
+    for (long unsigned i = 0; i < workload->size; i++)
+    {
+        long key = workload->ops[i].key;
+        long unsigned place = lowerBound(sorted, size, key);
+        int found = place < size && sorted[place] == key;
+        int expected = found;
+        if (workload->ops[i].type == WORKLOAD_INSERT && !found)
+        {
+            memmove(sorted + place + 1, sorted + place, (size - place) * sizeof(long));
+            sorted[place] = key;
+            size++;
+            expected = true;
+        }
+        else if (workload->ops[i].type == WORKLOAD_INSERT)
+        {
+            expected = false;
+        }
+        else if (workload->ops[i].type == WORKLOAD_DELETE && found)
+        {
+            memmove(sorted + place, sorted + place + 1, (size - place - 1) * sizeof(long));
+            size--;
+        }
+        if (answers[i] != expected)
+        {
+            if (result->mismatches == 0)
+            {
+                result->firstMismatch = i;
+            }
+            result->mismatches++;
+        }
+    }
+    return size;
+}
+
+/**
+ * the state of a comparison of the items of a tree with a sorted array.
+ */
+typedef struct ContentsComparison
+{
+    const long *sorted;
+    long unsigned size;
+    long unsigned index;
+} ContentsComparison;
+
+/**
+ * ForEach function that compares the next item of the tree with the next key of the array.
+ * @param pKey pointer to long
+ * @param pComparison pointer to ContentsComparison
+ * @return 1 if they are equal, 0 if not (stops the comparison).
+ */
+int matchNextKey(const void *pKey, void *pComparison)
+{
+    ContentsComparison *comparison = (ContentsComparison *) pComparison;
+    if (comparison->index >= comparison->size ||
+        comparison->sorted[comparison->index] != *(const long *) pKey)
+    {
+        return false;
+    }
+    comparison->index++;
+    return true;
+}
+
+/**
+ * @brief runs a workload on a new tree, and compares it with a reference sorted array.
+ * @param workload: the workload.
+ * @param policy: the balancing policy of the tree.
+ * @param checkEvery: check the invariants of the tree after every this many operations (0 - only
+ * at the end).
+ * @param result: set to the outcome of the run.
+ * @return 0 on failure, other on success.
+ */
+int runWorkload(const Workload *workload, BalancePolicy policy, long unsigned checkEvery,
+                WorkloadResult *result)
+{
+    if (workload == NULL || result == NULL)
+    {
+        return false;
+    }
+    memset(result, 0, sizeof(WorkloadResult));
+    result->firstMismatch = workload->size;
+    long *keys = (long *) malloc(2 * (size_t) workload->keyRange * sizeof(long));
+    char *answers = (char *) malloc(workload->size > 0 ? workload->size : 1);
+    RBTree *tree = newRBTreeWithPolicy(compareKeys, NULL, policy);
+    if (keys == NULL || answers == NULL || tree == NULL)
+    {
+        free(keys);
+        free(answers);
+        freeRBTree(&tree);
+        return false;
+    }
+    for (long key = 0; key < workload->keyRange; key++)
+    {
+        keys[key] = key;
+    }
+    long *sorted = keys + workload->keyRange;
+    runOnTree(workload, tree, keys, checkEvery, answers, result);
+    result->invariants |= checkRBTree(tree);
+    result->opsPerSecond = result->seconds > 0 ? (double) workload->size / result->seconds : 0;
+    result->height = RBTreeHeight(tree);
+    result->rotationsPerOp = workload->size > 0 ? (double) tree->rotations / workload->size : 0;
+    ContentsComparison comparison = {sorted, runOnReference(workload, sorted, answers, result), 0};
+    if (!forEachRBTree(tree, matchNextKey, &comparison) || comparison.index != comparison.size)
+    {
+        // the final items differ - counted as one more mismatch.
+        result->mismatches++;
+    }
+    free(keys);
+    free(answers);
+    freeRBTree(&tree);
+    return true;
+}
+
+//-------------- balancing policies benchmark. ----------------
+
+/**
+ * @brief runs one phase of the benchmark - an operation on every key, in the order of the keys -
+ * and times it.
+ * @param tree: the tree.
+ * @param keys: the keys.
+ * @param numKeys: number of keys.
+ * @param type: the operation.
+ * @param nanos: set to the average time of an operation, in nanoseconds.
+ * @param rotations: set to the average number of rotations of an operation.
+ * @return number of operations that succeeded.
+ */
+long unsigned runBenchmarkPhase(RBTree *tree, long *keys, long unsigned numKeys,
+                                WorkloadOpType type, double *nanos, double *rotations)
+{
+    long unsigned succeeded = 0, rotationsBefore = tree->rotations;
+    double begin = monotonicSeconds();
+    for (long unsigned i = 0; i < numKeys; i++)
+    {
+        switch (type)
+        {
+            case WORKLOAD_INSERT:
+                succeeded += insertToRBTree(tree, &keys[i]) != 0;
+                break;
+            case WORKLOAD_DELETE:
+                succeeded += deleteFromRBTree(tree, &keys[i]) != 0;
+                break;
+            default:
+                succeeded += RBTreeContains(tree, &keys[i]) != 0;
+                break;
+        }
+    }
+    double seconds = monotonicSeconds() - begin;
+    *nanos = numKeys > 0 ? seconds * 1e9 / (double) numKeys : 0;
+    *rotations = numKeys > 0 ? (double) (tree->rotations - rotationsBefore) / (double) numKeys : 0;
+    return succeeded;
+}
+
+/**
+ * @brief benchmarks a balancing policy: inserts distinct random keys, looks all of them up (in
+ * another random order), and deletes half of them.
+ * @param policy: the balancing policy.
+ * @param numKeys: number of keys.
+ * @param seed: the seed of the keys and their orders.
+ * @param benchmark: set to the outcome.
+ * @return 0 on failure, other on success.
+ */
+int benchmarkBalancePolicy(BalancePolicy policy, long unsigned numKeys, unsigned long long seed,
+                           PolicyBenchmark *benchmark)
+{
+    if (benchmark == NULL)
+    {
+        return false;
+    }
+    memset(benchmark, 0, sizeof(PolicyBenchmark));
+    // the tree borrows the first half of the keys, the lookups and deletes use the second.
+    long *keys = (long *) malloc((numKeys > 0 ? 2 * numKeys : 1) * sizeof(long));
+    RBTree *tree = newRBTreeWithPolicy(compareKeys, NULL, policy);
+    if (keys == NULL || tree == NULL)
+    {
+        free(keys);
+        freeRBTree(&tree);
+        return false;
+    }
+    // distinct keys in a random order: a shuffle of 0 .. numKeys - 1.
+    unsigned long long state = seed;
+    for (long unsigned i = 0; i < numKeys; i++)
+    {
+        keys[i] = (long) i;
+    }
+    for (long unsigned i = numKeys; i > 1; i--)
+    {
+        long unsigned j = (long unsigned) (nextRandom(&state) % i);
+        long key = keys[i - 1];
+        keys[i - 1] = keys[j];
+        keys[j] = key;
+    }
+    double unused;
+    long unsigned found = runBenchmarkPhase(tree, keys, numKeys, WORKLOAD_INSERT,
+                                            &benchmark->insertNanos,
+                                            &benchmark->rotationsPerInsert);
+    benchmark->height = RBTreeHeight(tree);
+    // the lookups are in the reverse order, so they do not follow the inserts' cache footprint.
+    long *probes = keys + numKeys;
+    for (long unsigned i = 0; i < numKeys; i++)
+    {
+        probes[i] = keys[numKeys - 1 - i];
+    }
+    found += runBenchmarkPhase(tree, probes, numKeys, WORKLOAD_CONTAINS, &benchmark->lookupNanos,
+                               &unused);
+    found += runBenchmarkPhase(tree, probes, numKeys / 2, WORKLOAD_DELETE, &benchmark->deleteNanos,
+                               &benchmark->rotationsPerDelete);
+    benchmark->invariants = checkRBTree(tree);
+    if (found != 2 * numKeys + numKeys / 2)
+    {
+        benchmark->invariants |= RBTREE_CHECK_SIZE;
+    }
+    free(keys);
+    freeRBTree(&tree);
+    return true;
+}
+
+//-------------- key prefix benchmark. ----------------
+
+// the CompareFunc calls of benchmarkKeyPrefix.
+static long unsigned benchmarkCompares = 0;
+
+/**
+ * @brief stringCompare that counts its calls.
+ * @param a, b: the strings.
+ * @return as stringCompare.
+ */
+int countingStringCompare(const void *a, const void *b)
+{
+    benchmarkCompares++;
+    return stringCompare(a, b);
+}
+
+/**
+ * @brief opens the hardware counter of the cache misses of the calling thread, disabled.
+ * @return the file descriptor of the counter, -1 if there is none.
+ */
+int openCacheMissCounter(void)
+{
+#ifdef __linux__
+    struct perf_event_attr attributes;
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.size = sizeof(attributes);
+    attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    return (int) syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+/**
+ * @brief starts or stops a counter opened with openCacheMissCounter.
+ * @param counter: the counter (-1 - none).
+ * @param enable: true to start, false to stop.
+ */
+void enableCacheMissCounter(int counter, int enable)
+{
+#ifdef __linux__
+    if (counter >= 0)
+    {
+        ioctl(counter, enable ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE, 0);
+    }
+#else
+    (void) counter;
+    (void) enable;
+#endif
+}
+
+/**
+ * @brief reads and closes a counter opened with openCacheMissCounter.
+ * @param counter: the counter (-1 - none).
+ * @return the cache misses it counted, -1 if there is no counter.
+ */
+double closeCacheMissCounter(int counter)
+{
+    double misses = -1;
+#ifdef __linux__
+    long long value;
+    if (counter >= 0 && read(counter, &value, sizeof(value)) == (ssize_t) sizeof(value))
+    {
+        misses = (double) value;
+    }
+    if (counter >= 0)
+    {
+        close(counter);
+    }
+#else
+    (void) counter;
+#endif
+    return misses;
+}
+
+/**
+ * @brief benchmarks the lookups of a tree of strings with or without the key prefixes.
+ * @param withPrefix: other than 0 to give the tree the key prefixes.
+ * @param numKeys: number of keys.
+ * @param keyLength: length of the keys.
+ * @param seed: the seed of the keys and their orders.
+ * @param benchmark: set to the outcome.
+ * @return 0 on failure, other on success.
+ */
+int benchmarkKeyPrefix(int withPrefix, long unsigned numKeys, int keyLength,
+                       unsigned long long seed, LookupBenchmark *benchmark)
+{
+    if (keyLength < 8 || benchmark == NULL)
+    {
+        return false;
+    }
+    memset(benchmark, 0, sizeof(LookupBenchmark));
+    RBTree *tree = newRBTree(countingStringCompare, freeString);
+    char **keys = (char **) calloc(numKeys + 1, sizeof(char *));
+    int status = tree != NULL && keys != NULL &&
+                 (!withPrefix || setRBTreeKeyPrefix(tree, stringKeyPrefix));
+    unsigned long long state = seed;
+    long unsigned inserted = 0;
+    for (long unsigned i = 0; status && i < numKeys; i++)
+    {
+        char *key = (char *) malloc(keyLength + 1);
+        status = key != NULL;
+        for (int c = 0; status && c < keyLength; c++)
+        {
+            key[c] = (char) ('a' + nextRandom(&state) % 26);
+        }
+        if (status)
+        {
+            key[keyLength] = '\0';
+            if (insertToRBTree(tree, key))
+            {
+                keys[inserted++] = key;
+            }
+            else
+            {
+                free(key);
+            }
+        }
+    }
+    // the lookups are in another order, so they do not follow the inserts' cache footprint.
+    for (long unsigned i = inserted; status && i > 1; i--)
+    {
+        long unsigned j = (long unsigned) (nextRandom(&state) % i);
+        char *key = keys[i - 1];
+        keys[i - 1] = keys[j];
+        keys[j] = key;
+    }
+    if (status && inserted > 0)
+    {
+        long unsigned found = 0;
+        benchmarkCompares = 0;
+        int counter = openCacheMissCounter();
+        double begin = monotonicSeconds();
+        enableCacheMissCounter(counter, true);
+        for (long unsigned i = 0; i < inserted; i++)
+        {
+            found += RBTreeContains(tree, keys[i]) != 0;
+        }
+        enableCacheMissCounter(counter, false);
+        double seconds = monotonicSeconds() - begin;
+        double misses = closeCacheMissCounter(counter);
+        benchmark->lookupNanos = seconds * 1e9 / (double) inserted;
+        benchmark->comparesPerLookup = (double) benchmarkCompares / (double) inserted;
+        benchmark->cacheMissesPerLookup = misses < 0 ? -1 : misses / (double) inserted;
+        benchmark->nodeBytes = inserted * (withPrefix ? sizeof(PrefixNode) : sizeof(Node));
+        status = found == inserted;
+    }
+    free(keys);
+    freeRBTree(&tree);
+    return status;
+}
+
+//-------------- skip list scaling benchmark. ----------------
+
+/**
+ * the gate the workers of a scaling run wait at, so they all start together. aborted is set if
+ * not all of them could be created - they quit as soon as the gate opens.
+ */
+typedef struct StartGate
+{
+    pthread_mutex_t lock;
+    pthread_cond_t opened;
+    int open;
+    int aborted;
+} StartGate;
+
+/**
+ * the share of a thread in a scaling run - a run of the operations of the workload, and the
+ * container they run on (a SkipList, or an RBTree and its lock).
+ */
+typedef struct ScalingWorker
+{
+    const Workload *workload;
+    long unsigned begin, end;
+    long *keys;
+    SkipList *list;
+    RBTree *tree;
+    pthread_mutex_t *lock;
+    StartGate *gate;
+    pthread_t thread;
+} ScalingWorker;
+
+/**
+ * @brief runs the operations of a worker, once all the workers are ready.
+ * @param pWorker: pointer to the ScalingWorker.
+ * @return NULL.
+ */
+void *runScalingWorker(void *pWorker)
+{
+    ScalingWorker *worker = (ScalingWorker *) pWorker;
+    pthread_mutex_lock(&worker->gate->lock);
+    while (!worker->gate->open)
+    {
+        pthread_cond_wait(&worker->gate->opened, &worker->gate->lock);
+    }
+    int aborted = worker->gate->aborted;
+    pthread_mutex_unlock(&worker->gate->lock);
+    if (aborted)
+    {
+        return NULL;
+    }
+    for (long unsigned i = worker->begin; i < worker->end; i++)
+    {
+        long *key = &worker->keys[worker->workload->ops[i].key];
+        WorkloadOpType type = worker->workload->ops[i].type;
+        if (worker->list != NULL)
+        {
+            if (type == WORKLOAD_INSERT)
+            {
+                insertToSkipList(worker->list, key);
+            }
+            else if (type == WORKLOAD_DELETE)
+            {
+                deleteFromSkipList(worker->list, key);
+            }
+            else
+            {
+                SkipListContains(worker->list, key);
+            }
+            continue;
+        }
+        pthread_mutex_lock(worker->lock);
+        if (type == WORKLOAD_INSERT)
+        {
+            insertToRBTree(worker->tree, key);
+        }
+        else if (type == WORKLOAD_DELETE)
+        {
+            deleteFromRBTree(worker->tree, key);
+        }
+        else
+        {
+            RBTreeContains(worker->tree, key);
+        }
+        pthread_mutex_unlock(worker->lock);
+    }
+    return NULL;
+}
+
+/**
+ * @brief runs a workload split between threads on one container, and times it.
+ * @param workload: the workload.
+ * @param keys: the keys of the workload (the container borrows them).
+ * @param numThreads: number of threads.
+ * @param list: the SkipList to run on, NULL to run on the tree.
+ * @param tree: the RBTree to run on (if list is NULL).
+ * @param opsPerSecond: set to the throughput.
+ * @return 0 on failure, other on success.
+ */
+int runScaling(const Workload *workload, long *keys, int numThreads, SkipList *list,
+               RBTree *tree, double *opsPerSecond)
+{
+    ScalingWorker *workers = (ScalingWorker *) malloc(numThreads * sizeof(ScalingWorker));
+    if (workers == NULL)
+    {
+        return false;
+    }
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    StartGate gate = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, false, false};
+    int created = 0;
+    for (; created < numThreads; created++)
+    {
+        ScalingWorker *worker = &workers[created];
+        worker->workload = workload;
+        worker->begin = workload->size * created / numThreads;
+        worker->end = workload->size * (created + 1) / numThreads;
+        worker->keys = keys;
+        worker->list = list;
+        worker->tree = tree;
+        worker->lock = &lock;
+        worker->gate = &gate;
+        if (pthread_create(&worker->thread, NULL, runScalingWorker, worker) != 0)
+        {
+            break;
+        }
+    }
+    pthread_mutex_lock(&gate.lock);
+    gate.open = true;
+    gate.aborted = created < numThreads;
+    pthread_cond_broadcast(&gate.opened);
+    pthread_mutex_unlock(&gate.lock);
+    double begin = monotonicSeconds();
+    for (int i = 0; i < created; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+    }
+    double seconds = monotonicSeconds() - begin;
+    *opsPerSecond = seconds > 0 ? (double) workload->size / seconds : 0;
+    free(workers);
+    return created == numThreads;
+}
+
+/**
+ * @brief benchmarks the scaling of a SkipList against a mutex-wrapped RBTree.
+ * @param workload: the workload.
+ * @param maxThreads: the largest number of threads.
+ * @param points: an array of maxThreads points, set to the outcomes.
+ * @return 0 on failure, other on success.
+ */
+int benchmarkSkipListScaling(const Workload *workload, int maxThreads, ScalingPoint *points)
+{
+    if (workload == NULL || maxThreads <= 0 || points == NULL)
+    {
+        return false;
+    }
+    long *keys = (long *) malloc((size_t) workload->keyRange * sizeof(long));
+    if (keys == NULL)
+    {
+        return false;
+    }
+    for (long key = 0; key < workload->keyRange; key++)
+    {
+        keys[key] = key;
+    }
+    int status = true;
+    for (int threads = 1; threads <= maxThreads && status; threads++)
+    {
+        points[threads - 1].threads = threads;
+        SkipList *list = newSkipList(compareKeys, NULL);
+        RBTree *tree = newRBTree(compareKeys, NULL);
+        status = list != NULL && tree != NULL &&
+                 runScaling(workload, keys, threads, list, NULL,
+                            &points[threads - 1].skipListOpsPerSecond) &&
+                 runScaling(workload, keys, threads, NULL, tree,
+                            &points[threads - 1].lockedTreeOpsPerSecond);
+        freeSkipList(&list);
+        freeRBTree(&tree);
+    }
+    free(keys);
+    return status;
+}
+
+//-------------- vector index benchmark. ----------------
+
+/**
+ * the state of a brute-force k nearest neighbors scan - the best vectors found so far, sorted by
+ * their squared distance from the query (closest first).
+ */
+typedef struct NearestScan
+{
+    const Vector *query;
+    int k;
+    int found;
+    double *distances;
+    const Vector **vectors;
+    double squaredRadius;
+    long unsigned matches;
+} NearestScan;
+
+/**
+ * @brief the squared L2 distance of a vector from the query of a scan.
+ * @param scan: the scan.
+ * @param vector: the vector, of the same length as the query.
+ * @return the squared distance.
+ */
+double scanSquaredDistance(const NearestScan *scan, const Vector *vector)
+{
+    double distance = 0;
+    for (int i = 0; i < vector->len; i++)
+    {
+        double difference = vector->vector[i] - scan->query->vector[i];
+        distance += difference * difference;
+    }
+    return distance;
+}
+
+/**
+ * @brief forEachFunc of the scan of k nearest neighbors - keeps the vector if it is one of the k
+ * closest so far.
+ * @param pVector: pointer to Vector.
+ * @param pScan: pointer to NearestScan.
+ * @return 1.
+ */
+int offerToNearestScan(const void *pVector, void *pScan)
+{
+    const Vector *vector = (const Vector *) pVector;
+    NearestScan *scan = (NearestScan *) pScan;
+    double distance = scanSquaredDistance(scan, vector);
+    if (scan->found == scan->k && distance >= scan->distances[scan->k - 1])
+    {
+        return true;
+    }
+    int i = scan->found < scan->k ? scan->found++ : scan->k - 1;
+    for (; i > 0 && scan->distances[i - 1] > distance; i--)
+    {
+        scan->distances[i] = scan->distances[i - 1];
+        scan->vectors[i] = scan->vectors[i - 1];
+    }
+    scan->distances[i] = distance;
+    scan->vectors[i] = vector;
+    return true;
+}
+
+/**
+ * @brief forEachFunc of the scan of a radius query - counts the vectors within the radius.
+ * @param pVector: pointer to Vector.
+ * @param pScan: pointer to NearestScan.
+ * @return 1.
+ */
+int countInRadiusScan(const void *pVector, void *pScan)
+{
+    NearestScan *scan = (NearestScan *) pScan;
+    scan->matches += scanSquaredDistance(scan, (const Vector *) pVector) <= scan->squaredRadius;
+    return true;
+}
+
+/**
+ * @brief draws a random vector in [0, 1)^dim.
+ * @param dim: length of the vector.
+ * @param state: the state of the generator.
+ * @return the vector (to be freed with freeVector), NULL on failure.
+ */
+Vector *newRandomVector(int dim, unsigned long long *state)
+{
+    Vector *vector = (Vector *) malloc(sizeof(Vector));
+    double *elements = (double *) malloc(dim * sizeof(double));
+    if (vector == NULL || elements == NULL)
+    {
+        free(vector);
+        free(elements);
+        return NULL;
+    }
+    for (int i = 0; i < dim; i++)
+    {
+        // the top 53 bits, as a fraction.
+        elements[i] = (double) (nextRandom(state) >> 11) / 9007199254740992.0;
+    }
+    vector->vector = elements;
+    vector->len = dim;
+    return vector;
+}
+
+/**
+ * @brief runs the queries of the benchmark on the index and on the scan.
+ * @param tree: the tree of vectors.
+ * @param index: the index of the tree.
+ * @param queries: the queries.
+ * @param numQueries: number of queries.
+ * @param scan: a scan with room for k vectors, and the radius.
+ * @param neighbors: room for k vectors.
+ * @param benchmark: the times and the mismatches are set here.
+ */
+void runVectorIndexQueries(const RBTree *tree, const VectorIndex *index, Vector **queries,
+                           int numQueries, NearestScan *scan, const Vector **neighbors,
+                           VectorIndexBenchmark *benchmark)
+{
+    double indexSeconds = 0, scanSeconds = 0, radius = sqrt(scan->squaredRadius);
+    for (int q = 0; q < numQueries; q++)
+    {
+        scan->query = queries[q];
+        double begin = monotonicSeconds();
+        int found = findKNearestVectors(index, queries[q], scan->k, neighbors);
+        double middle = monotonicSeconds();
+        scan->found = 0;
+        forEachRBTree(tree, offerToNearestScan, scan);
+        scanSeconds += monotonicSeconds() - middle;
+        indexSeconds += middle - begin;
+        // ties may be broken differently - the distances must be the same.
+        int mismatch = found != scan->found;
+        for (int i = 0; i < found && !mismatch; i++)
+        {
+            mismatch = scanSquaredDistance(scan, neighbors[i]) != scan->distances[i];
+        }
+        benchmark->mismatches += mismatch;
+    }
+    benchmark->indexKnnNanos = indexSeconds * 1e9 / numQueries;
+    benchmark->scanKnnNanos = scanSeconds * 1e9 / numQueries;
+    indexSeconds = scanSeconds = 0;
+    long unsigned matches = 0;
+    for (int q = 0; q < numQueries; q++)
+    {
+        scan->query = queries[q];
+        scan->matches = 0;
+        double begin = monotonicSeconds();
+        int found = findVectorsInRadius(index, queries[q], radius, NULL, 0);
+        double middle = monotonicSeconds();
+        forEachRBTree(tree, countInRadiusScan, scan);
+        scanSeconds += monotonicSeconds() - middle;
+        indexSeconds += middle - begin;
+        benchmark->mismatches += (long unsigned) found != scan->matches;
+        matches += scan->matches;
+    }
+    benchmark->indexRadiusNanos = indexSeconds * 1e9 / numQueries;
+    benchmark->scanRadiusNanos = scanSeconds * 1e9 / numQueries;
+    benchmark->matchesPerRadiusQuery = (double) matches / numQueries;
+    benchmark->knnSpeedup = benchmark->indexKnnNanos > 0 ?
+                            benchmark->scanKnnNanos / benchmark->indexKnnNanos : 0;
+    benchmark->radiusSpeedup = benchmark->indexRadiusNanos > 0 ?
+                               benchmark->scanRadiusNanos / benchmark->indexRadiusNanos : 0;
+}
+
+/**
+ * @brief benchmarks the KD-tree of a tree of vectors against a brute-force scan of the tree.
+ * @param numVectors: number of vectors.
+ * @param dim: length of the vectors.
+ * @param numQueries: number of queries of each kind.
+ * @param k: number of neighbors of a k nearest neighbors query.
+ * @param radius: the radius of a radius query.
+ * @param seed: the seed of the vectors and the queries.
+ * @param benchmark: set to the outcome.
+ * @return 0 on failure, other on success.
+ */
+int benchmarkVectorIndex(long unsigned numVectors, int dim, int numQueries, int k, double radius,
+                         unsigned long long seed, VectorIndexBenchmark *benchmark)
+{
+    if (dim <= 0 || numQueries <= 0 || k <= 0 || radius < 0 || benchmark == NULL)
+    {
+        return false;
+    }
+    memset(benchmark, 0, sizeof(VectorIndexBenchmark));
+    unsigned long long state = seed;
+    RBTree *tree = newRBTree(vectorCompare1By1, freeVector);
+    Vector **queries = (Vector **) calloc(numQueries, sizeof(Vector *));
+    NearestScan scan = {NULL, k, 0, (double *) malloc(k * sizeof(double)),
+                        (const Vector **) malloc(k * sizeof(Vector *)), radius * radius, 0};
+    const Vector **neighbors = (const Vector **) malloc(k * sizeof(Vector *));
+    int status = tree != NULL && queries != NULL && scan.distances != NULL &&
+                 scan.vectors != NULL && neighbors != NULL;
+    for (long unsigned i = 0; status && i < numVectors; i++)
+    {
+        Vector *vector = newRandomVector(dim, &state);
+        status = vector != NULL;
+        if (status && !insertToRBTree(tree, vector))
+        {
+            // an equal vector is already in the tree.
+            freeVector(vector);
+        }
+    }
+    for (int q = 0; status && q < numQueries; q++)
+    {
+        queries[q] = newRandomVector(dim, &state);
+        status = queries[q] != NULL;
+    }
+    VectorIndex *index = NULL;
+    if (status)
+    {
+        double begin = monotonicSeconds();
+        index = newVectorIndex(tree);
+        benchmark->buildNanos = (monotonicSeconds() - begin) * 1e9;
+        status = index != NULL;
+    }
+    if (status)
+    {
+        runVectorIndexQueries(tree, index, queries, numQueries, &scan, neighbors, benchmark);
+    }
+    freeVectorIndex(&index);
+    for (int q = 0; queries != NULL && q < numQueries; q++)
+    {
+        freeVector(queries[q]);
+    }
+    free(queries);
+    free(scan.distances);
+    free(scan.vectors);
+    free(neighbors);
+    freeRBTree(&tree);
+    return status;
+}
@@ -0,0 +1,251 @@
+#ifndef RBTREE_RBTREECHECK_H
+#define RBTREE_RBTREECHECK_H
+
+#include "RBTree.h"
+
+/**
+ * the invariants checkRBTree verifies - it returns the bits of the ones that are broken.
+ * RBTREE_CHECK_ORDER: every item is larger than all the items of its left sub-tree and smaller
+ * than all the items of its right sub-tree.
+ * RBTREE_CHECK_ROOT_COLOR: the root has no parent (and is black, in a red-black tree).
+ * RBTREE_CHECK_RED_RED: a red node has no red child (red-black trees only).
+ * RBTREE_CHECK_BLACK_HEIGHT: all the paths from a node down to a missing child have the same
+ * number of black nodes (red-black trees only).
+ * RBTREE_CHECK_PARENTS: the parent of every child is its node. the parents (of the root too) are
+ * not checked in a tree with clones (RBTreeClone) - its descents set them on the way.
+ * RBTREE_CHECK_SIZE: size is the number of nodes.
+ * RBTREE_CHECK_NODES: the cached state of the nodes - every key prefix is the prefix of its item,
+ * every count is positive (1 in a set), every sub-tree size is the sum of its children's plus
+ * one, and the finger is a node of the tree.
+ * RBTREE_CHECK_MEMORY: the check could not allocate its memory.
+ * RBTREE_CHECK_BALANCE: in an AVL tree, the rank of every node is its height and the heights of
+ * its children differ by at most 1. in a treap, no node has a higher priority than its parent.
+ */
+typedef enum RBTreeCheckFlags
+{
+	RBTREE_CHECK_ORDER = 1 << 0,
+	RBTREE_CHECK_ROOT_COLOR = 1 << 1,
+	RBTREE_CHECK_RED_RED = 1 << 2,
+	RBTREE_CHECK_BLACK_HEIGHT = 1 << 3,
+	RBTREE_CHECK_PARENTS = 1 << 4,
+	RBTREE_CHECK_SIZE = 1 << 5,
+	RBTREE_CHECK_NODES = 1 << 6,
+	RBTREE_CHECK_MEMORY = 1 << 7,
+	RBTREE_CHECK_BALANCE = 1 << 8
+} RBTreeCheckFlags;
+
+/**
+ * checks all the invariants of a tree, without recursion (so a broken, degenerate tree can be
+ * checked too).
+ * @param tree: the tree to check.
+ * @return: 0 if the tree is valid, otherwise the RBTreeCheckFlags of the broken invariants.
+ */
+int checkRBTree(const RBTree *tree);
+
+/**
+ * the kinds of operations of a workload.
+ */
+typedef enum WorkloadOpType
+{
+	WORKLOAD_INSERT, WORKLOAD_DELETE, WORKLOAD_CONTAINS
+} WorkloadOpType;
+
+/**
+ * an operation of a workload on the key key.
+ */
+typedef struct WorkloadOp
+{
+	WorkloadOpType type;
+	long key;
+} WorkloadOp;
+
+/**
+ * a sequence of operations on a tree of keys 0 .. keyRange - 1. the same seed and parameters
+ * always generate the same workload, on every machine, so a failing run can be replayed.
+ */
+typedef struct Workload
+{
+	WorkloadOp *ops;
+	long unsigned size;
+	long keyRange;
+} Workload;
+
+/**
+ * generates a workload.
+ * @param seed: the seed of the generator.
+ * @param numOps: number of operations.
+ * @param keyRange: the keys are drawn uniformly from 0 .. keyRange - 1.
+ * @param readPercent: percent of contains operations (0 - 100). the rest are inserts and deletes,
+ * half each.
+ * @return a new workload. if creation failed, returns NULL.
+ */
+Workload *newWorkload(unsigned long long seed, long unsigned numOps, long keyRange,
+					  int readPercent);
+
+/**
+ * the outcome of runWorkload.
+ * mismatches: number of operations whose result differed from the reference, plus one if the
+ * final items differ.
+ * firstMismatch: index of the first such operation (the size of the workload if there is none).
+ * invariants: the RBTreeCheckFlags of all the invariants that were found broken.
+ * seconds: time spent in the operations of the tree only.
+ * opsPerSecond: throughput of the tree.
+ * height: the height of the tree at the end.
+ * rotationsPerOp: average number of rotations of an operation.
+ */
+typedef struct WorkloadResult
+{
+	long unsigned mismatches;
+	long unsigned firstMismatch;
+	int invariants;
+	double seconds;
+	double opsPerSecond;
+	int height;
+	double rotationsPerOp;
+} WorkloadResult;
+
+/**
+ * runs a workload on a new tree, and compares the result of every operation - and the final
+ * items - with a reference sorted array. the comparison and the checks are not timed, so with
+ * checkEvery 0 the run doubles as a benchmark of the mix of operations.
+ * @param workload: the workload.
+ * @param policy: the balancing policy of the tree.
+ * @param checkEvery: check the invariants of the tree after every this many operations (0 - only
+ * at the end).
+ * @param result: set to the outcome of the run.
+ * @return: 0 on failure (allocation failure), other on success - even if mismatches were found.
+ */
+int runWorkload(const Workload *workload, BalancePolicy policy, long unsigned checkEvery,
+				WorkloadResult *result);
+
+/**
+ * free the workload.
+ * @param workload: pointer to the workload to free.
+ */
+void freeWorkload(Workload **workload);
+
+/**
+ * the outcome of benchmarkBalancePolicy.
+ * height: the height of the tree after all the keys were inserted.
+ * insertNanos, lookupNanos, deleteNanos: average time of an operation, in nanoseconds.
+ * rotationsPerInsert, rotationsPerDelete: average number of rotations of an operation.
+ * invariants: the RBTreeCheckFlags of the invariants broken at the end (RBTREE_CHECK_SIZE if an
+ * operation failed).
+ */
+typedef struct PolicyBenchmark
+{
+	int height;
+	double insertNanos;
+	double lookupNanos;
+	double deleteNanos;
+	double rotationsPerInsert;
+	double rotationsPerDelete;
+	int invariants;
+} PolicyBenchmark;
+
+/**
+ * benchmarks a balancing policy on a new tree: inserts numKeys distinct keys in a random order,
+ * looks all of them up in another order, and deletes half of them.
+ * @param policy: the balancing policy.
+ * @param numKeys: number of keys.
+ * @param seed: the seed of the order of the keys - the same seed always gives the same orders.
+ * @param benchmark: set to the outcome.
+ * @return: 0 on failure (allocation failure), other on success.
+ */
+int benchmarkBalancePolicy(BalancePolicy policy, long unsigned numKeys, unsigned long long seed,
+						   PolicyBenchmark *benchmark);
+
+/**
+ * the outcome of benchmarkKeyPrefix.
+ * lookupNanos: average time of a lookup, in nanoseconds.
+ * comparesPerLookup: average number of CompareFunc calls of a lookup - each one reads an item
+ * outside the nodes.
+ * cacheMissesPerLookup: average number of cache misses of a lookup, by the hardware counter of
+ * the CPU. -1 if there is no such counter (not Linux, or no access to it).
+ * nodeBytes: the memory of the nodes of the tree.
+ */
+typedef struct LookupBenchmark
+{
+	double lookupNanos;
+	double comparesPerLookup;
+	double cacheMissesPerLookup;
+	size_t nodeBytes;
+} LookupBenchmark;
+
+/**
+ * benchmarks the lookups of a tree of strings with and without the key prefixes in the nodes
+ * (setRBTreeKeyPrefix with stringKeyPrefix): inserts numKeys random distinct strings, each
+ * allocated on its own, and looks all of them up in another random order.
+ * @param withPrefix: other than 0 to give the tree the key prefixes.
+ * @param numKeys: number of keys.
+ * @param keyLength: length of the keys (at least 8).
+ * @param seed: the seed of the keys and their orders.
+ * @param benchmark: set to the outcome.
+ * @return: 0 on failure (allocation failure or invalid parameters), other on success.
+ */
+int benchmarkKeyPrefix(int withPrefix, long unsigned numKeys, int keyLength,
+					   unsigned long long seed, LookupBenchmark *benchmark);
+
+/**
+ * the outcome of benchmarkSkipListScaling for one number of threads.
+ * threads: number of threads.
+ * skipListOpsPerSecond: throughput of a SkipList shared by the threads.
+ * lockedTreeOpsPerSecond: throughput of an RBTree shared by the threads behind a mutex.
+ */
+typedef struct ScalingPoint
+{
+	int threads;
+	double skipListOpsPerSecond;
+	double lockedTreeOpsPerSecond;
+} ScalingPoint;
+
+/**
+ * benchmarks the scaling of a SkipList against a mutex-wrapped RBTree: for every number of threads
+ * from 1 to maxThreads, the operations of the workload are split between the threads (in
+ * contiguous runs), and run on a new, shared container of each kind.
+ * @param workload: the workload.
+ * @param maxThreads: the largest number of threads.
+ * @param points: an array of maxThreads points, point i is set to the outcome of i + 1 threads.
+ * @return: 0 on failure (allocation or thread creation failure), other on success.
+ */
+int benchmarkSkipListScaling(const Workload *workload, int maxThreads, ScalingPoint *points);
+
+/**
+ * the outcome of benchmarkVectorIndex. the times are averages of a query, in nanoseconds.
+ * buildNanos: time to build the index (all of it).
+ * indexKnnNanos, scanKnnNanos: k nearest neighbors with the index, and with a scan of the tree.
+ * indexRadiusNanos, scanRadiusNanos: a radius query with the index, and with a scan of the tree.
+ * knnSpeedup, radiusSpeedup: the time of the scan divided by the time of the index.
+ * matchesPerRadiusQuery: average number of vectors in the radius of a query.
+ * mismatches: number of queries whose answer from the index differed from the scan's.
+ */
+typedef struct VectorIndexBenchmark
+{
+	double buildNanos;
+	double indexKnnNanos;
+	double scanKnnNanos;
+	double knnSpeedup;
+	double indexRadiusNanos;
+	double scanRadiusNanos;
+	double radiusSpeedup;
+	double matchesPerRadiusQuery;
+	long unsigned mismatches;
+} VectorIndexBenchmark;
+
+/**
+ * benchmarks the KD-tree of a tree of Vectors (newVectorIndex) against a brute-force scan of the
+ * tree (forEachRBTree): builds a tree of numVectors random vectors in [0, 1)^dim, and runs the same
+ * random queries on both - k nearest neighbors, and all the vectors within radius.
+ * @param numVectors: number of vectors.
+ * @param dim: length of the vectors.
+ * @param numQueries: number of queries of each kind.
+ * @param k: number of neighbors of a k nearest neighbors query.
+ * @param radius: the radius of a radius query.
+ * @param seed: the seed of the vectors and the queries.
+ * @param benchmark: set to the outcome.
+ * @return: 0 on failure (allocation failure or invalid parameters), other on success.
+ */
+int benchmarkVectorIndex(long unsigned numVectors, int dim, int numQueries, int k, double radius,
+						 unsigned long long seed, VectorIndexBenchmark *benchmark);
+
+#endif //RBTREE_RBTREECHECK_H
@@ -0,0 +1,636 @@
+/**
+ * @file ShardedRBTree.c
+ * @date 18 october 2026
+ * @brief a container of several locked RBTrees, split by key range or by hash.
+*/
+
+#if !defined(__STDC_VERSION__) || __STDC_VERSION__ < 201112L || defined(__STDC_NO_ATOMICS__)
+#error "ShardedRBTree.c needs C11 atomics (compile with -std=c11 or later)"
+#endif
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "ShardedRBTree.h"
+#define SKEW_CHECK_INTERVAL 1024
+#define SKEW_FACTOR 2
+#define MIN_ITEMS_PER_SHARD_TO_REBALANCE 64
+#define SAMPLE_ARENA_BLOCK_SIZE 4096
+
+/**
+ * a shard - a tree and the lock that guards it. size mirrors tree->size, so it can be read without
+ * the lock.
+ */
+typedef struct Shard
+{
+    RBTree *tree;
+    pthread_mutex_t lock;
+    atomic_ulong size;
+} Shard;
+
+/**
+ * represents the container. in range mode, items smaller than splitters[0] are in shard 0, items
+ * in [splitters[i - 1], splitters[i]) in shard i. a NULL splitter stands for infinity.
+ * if an item that serves as a splitter is deleted, it is orphaned - it is freed only once a
+ * rebalance replaces it. a borrowed item goes back to the caller, so it is replaced right away
+ * (replaceSplitter). a splitter that came from a sample (splitterSampled) is replaced with the
+ * smallest item of its shard on the first insert into the shard. sampleArena holds the copies of
+ * the sample items, and is freed once no splitter is sampled.
+ */
+struct ShardedRBTree
+{
+    Shard *shards;
+    int numShards;
+    CompareFunc compFunc;
+    FreeFunc freeFunc;
+    HashFunc hashFunc;
+    void **splitters;
+    int *splitterOrphaned;
+    int *splitterSampled;
+    Arena *sampleArena;
+    pthread_rwlock_t splittersLock;
+    atomic_ulong insertCount;
+};
+
+/**
+ * @brief constructs a new ShardedRBTree.
+ * @param compFunc: a function two compare two variables.
+ * @param freeFunc: a function that frees the items (NULL - the container borrows its items).
+ * @param numShards: number of shards.
+ * @param hashFunc: NULL to shard by key range, otherwise the items are sharded by this hash.
+ * @return a new sharded tree. if creation failed, returns NULL.
+ */
+ShardedRBTree *newShardedRBTree(CompareFunc compFunc, FreeFunc freeFunc, int numShards,
+                                HashFunc hashFunc)
+{
+    if (compFunc == NULL || numShards <= 0)
+    {
+        return NULL;
+    }
+    ShardedRBTree *tree = (ShardedRBTree *) calloc(1, sizeof(ShardedRBTree));
+    if (tree == NULL)
+    {
+        return NULL;
+    }
+    tree->shards = (Shard *) calloc(numShards, sizeof(Shard));
+    tree->splitters = (void **) calloc(numShards, sizeof(void *));
+    tree->splitterOrphaned = (int *) calloc(numShards, sizeof(int));
+    tree->splitterSampled = (int *) calloc(numShards, sizeof(int));
+    if (tree->shards == NULL || tree->splitters == NULL || tree->splitterOrphaned == NULL ||
+        tree->splitterSampled == NULL || pthread_rwlock_init(&tree->splittersLock, NULL) != 0)
+    {
+        free(tree->shards);
+        free(tree->splitters);
+        free(tree->splitterOrphaned);
+        free(tree->splitterSampled);
+        free(tree);
+        return NULL;
+    }
+    tree->compFunc = compFunc;
+    tree->freeFunc = freeFunc;
+    tree->hashFunc = hashFunc;
+    atomic_init(&tree->insertCount, 0);
+    for (; tree->numShards < numShards; tree->numShards++)
+    {
+        Shard *shard = &tree->shards[tree->numShards];
+        shard->tree = newRBTree(compFunc, freeFunc);
+        if (shard->tree == NULL || pthread_mutex_init(&shard->lock, NULL) != 0)
+        {
+            freeRBTree(&shard->tree);
+            freeShardedRBTree(&tree);
+            return NULL;
+        }
+        atomic_init(&shard->size, 0);
+    }
+    return tree;
+}
+
+/**
+ * @brief finds the shard of an item. the caller holds the splitters lock.
+ * @param tree: the container.
+ * @param data: the item.
+ * @return index of the shard.
+ */
+int findShard(const ShardedRBTree *tree, const void *data)
+{
+    if (tree->hashFunc != NULL)
+    {
+        return (int) (tree->hashFunc(data) % (unsigned long) tree->numShards);
+    }
+    // the number of splitters that are not larger than data.
+    int lo = 0, hi = tree->numShards - 1;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (tree->splitters[mid] != NULL && tree->compFunc(tree->splitters[mid], data) <= 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * @brief gets the shard of an item, with the splitters lock held for reading and the shard
+ * locked. release it with releaseShard.
+ * @param tree: the container.
+ * @param data: the item.
+ * @return index of the shard.
+ */
+int acquireShard(ShardedRBTree *tree, const void *data)
+{
+    pthread_rwlock_rdlock(&tree->splittersLock);
+    int index = findShard(tree, data);
+    pthread_mutex_lock(&tree->shards[index].lock);
+    return index;
+}
+
+/**
+ * @brief releases a shard acquired with acquireShard.
+ * @param tree: the container.
+ * @param index: index of the shard.
+ */
+void releaseShard(ShardedRBTree *tree, int index)
+{
+    Shard *shard = &tree->shards[index];
+    atomic_store(&shard->size, shard->tree->size);
+    pthread_mutex_unlock(&shard->lock);
+    pthread_rwlock_unlock(&tree->splittersLock);
+}
+
+/**
+ * @brief sets the split points of a range-sharded tree by the quantiles of a sample of items.
+ * with a RelocateFunc the splitters are copies of the sample items, so the sample may be freed
+ * when the call returns. otherwise the sample items are borrowed until each is replaced with the
+ * smallest item of the shard it bounds, on the first insert into that shard (or by a rebalance).
+ * @param tree: an empty range-sharded tree.
+ * @param sample: items that represent the expected distribution of the keys.
+ * @param sampleSize: number of items in sample.
+ * @param relocateFunc: copies an item into an arena, NULL to borrow the sample items.
+ * @return 0 on failure, other on success. (if the tree is not empty or sharded by hash - failure).
+ */
+int sampleShardedRBTreeSplitters(ShardedRBTree *tree, void *const *sample, int sampleSize,
+                                 RelocateFunc relocateFunc)
+{
+    if (tree == NULL || tree->hashFunc != NULL || sample == NULL || sampleSize <= 0)
+    {
+        return false;
+    }
+    // an RBTree sorts the sample and drops its duplicates.
+    RBTree *sorted = newRBTree(tree->compFunc, NULL);
+    Arena *arena = relocateFunc == NULL ? NULL : newArena(SAMPLE_ARENA_BLOCK_SIZE);
+    if (sorted == NULL || (relocateFunc != NULL && arena == NULL))
+    {
+        freeRBTree(&sorted);
+        freeArena(&arena);
+        return false;
+    }
+    for (int i = 0; i < sampleSize; i++)
+    {
+        if (sample[i] != NULL && !RBTreeContains(sorted, sample[i]) &&
+            !insertToRBTree(sorted, sample[i]))
+        {
+            freeRBTree(&sorted);
+            freeArena(&arena);
+            return false;
+        }
+    }
+    // the splitter of shard i + 1 is the sample item at the (i + 1) / numShards quantile.
+    void **chosen = (void **) calloc(tree->numShards, sizeof(void *));
+    int status = chosen != NULL;
+    Node *node = RBTreeFirst(sorted);
+    long unsigned rank = 0;
+    for (int i = 0; status && i < tree->numShards - 1; i++)
+    {
+        long unsigned target = sorted->size * (i + 1) / tree->numShards;
+        while (node != NULL && rank < target)
+        {
+            node = RBTreeNext(node);
+            rank++;
+        }
+        chosen[i] = node == NULL ? NULL : node->data;
+        if (chosen[i] != NULL && relocateFunc != NULL)
+        {
+            chosen[i] = relocateFunc(chosen[i], arena);
+            status = chosen[i] != NULL;
+        }
+    }
+    freeRBTree(&sorted);
+    pthread_rwlock_wrlock(&tree->splittersLock);
+    status = status && shardedRBTreeSize(tree) == 0;
+    if (status)
+    {
+        for (int i = 0; i < tree->numShards - 1; i++)
+        {
+            tree->splitters[i] = chosen[i];
+            tree->splitterOrphaned[i] = false;
+            tree->splitterSampled[i] = chosen[i] != NULL;
+        }
+        // the copies of an earlier sample are not splitters anymore.
+        Arena *previous = tree->sampleArena;
+        tree->sampleArena = arena;
+        arena = previous;
+    }
+    pthread_rwlock_unlock(&tree->splittersLock);
+    free(chosen);
+    freeArena(&arena);
+    return status;
+}
+
+/**
+ * @brief replaces the sampled splitters of the non-empty shards with the smallest items of the
+ * shards, so they do not point into the sample anymore. frees the copies of the sample once no
+ * splitter is sampled.
+ * @param tree: the container.
+ */
+void replaceSampledSplitters(ShardedRBTree *tree)
+{
+    pthread_rwlock_wrlock(&tree->splittersLock);
+    int sampled = false;
+    for (int i = 0; i < tree->numShards - 1; i++)
+    {
+        if (!tree->splitterSampled[i])
+        {
+            continue;
+        }
+        // the items of shard i + 1 are not smaller than its splitter, so shard i keeps its items.
+        Node *first = RBTreeFirst(tree->shards[i + 1].tree);
+        if (first != NULL)
+        {
+            tree->splitters[i] = first->data;
+            tree->splitterSampled[i] = false;
+        }
+        sampled = sampled || tree->splitterSampled[i];
+    }
+    if (!sampled)
+    {
+        freeArena(&tree->sampleArena);
+    }
+    pthread_rwlock_unlock(&tree->splittersLock);
+}
+
+/**
+ * @brief checks whether one shard holds much more than its share of the items.
+ * @param tree: the container.
+ * @return true if the container should be rebalanced.
+ */
+int isShardedRBTreeSkewed(ShardedRBTree *tree)
+{
+    long unsigned total = 0, largest = 0;
+    for (int i = 0; i < tree->numShards; i++)
+    {
+        long unsigned size = atomic_load(&tree->shards[i].size);
+        total += size;
+        largest = size > largest ? size : largest;
+    }
+    return total >= (long unsigned) tree->numShards * MIN_ITEMS_PER_SHARD_TO_REBALANCE &&
+           largest * tree->numShards > total * SKEW_FACTOR;
+}
+
+/**
+ * @brief add an item to the container.
+ * @param tree: the container to add an item to.
+ * @param data: item to add.
+ * @return 0 on failure, other on success. (if the item is already in the container - failure).
+ */
+int insertToShardedRBTree(ShardedRBTree *tree, void *data)
+{
+    if (tree == NULL || data == NULL)
+    {
+        return false;
+    }
+    int index = acquireShard(tree, data);
+    int status = insertToRBTree(tree->shards[index].tree, data);
+    int sampled = status && index > 0 && tree->hashFunc == NULL &&
+                  tree->splitterSampled[index - 1];
+    releaseShard(tree, index);
+    if (sampled)
+    {
+        replaceSampledSplitters(tree);
+    }
+    if (status && tree->hashFunc == NULL && tree->numShards > 1 &&
+        atomic_fetch_add(&tree->insertCount, 1) % SKEW_CHECK_INTERVAL == 0 &&
+        isShardedRBTreeSkewed(tree))
+    {
+        rebalanceShardedRBTree(tree);
+    }
+    return status;
+}
+
+/**
+ * @brief replaces a deleted item that serves as a splitter with the smallest item of the shard it
+ * bounded from below - or, if that shard is empty, with the next splitter. the shards all keep
+ * the same items.
+ * @param tree: the container.
+ * @param removed: the deleted item.
+ */
+void replaceSplitter(ShardedRBTree *tree, const void *removed)
+{
+    pthread_rwlock_wrlock(&tree->splittersLock);
+    // from the last splitter down, so the next splitter is already replaced.
+    for (int i = tree->numShards - 2; i >= 0; i--)
+    {
+        if (tree->splitters[i] != removed)
+        {
+            continue;
+        }
+        Node *first = RBTreeFirst(tree->shards[i + 1].tree);
+        if (first != NULL)
+        {
+            tree->splitters[i] = first->data;
+        }
+        else
+        {
+            tree->splitters[i] = i + 1 == tree->numShards - 1 ? NULL : tree->splitters[i + 1];
+        }
+        tree->splitterOrphaned[i] = false;
+    }
+    pthread_rwlock_unlock(&tree->splittersLock);
+}
+
+/**
+ * @brief remove an item from the container.
+ * @param tree: the container to remove an item from.
+ * @param data: item to remove.
+ * @return 0 on failure, other on success. (if data is not in the container - failure).
+ */
+int deleteFromShardedRBTree(ShardedRBTree *tree, void *data)
+{
+    if (tree == NULL || data == NULL)
+    {
+        return false;
+    }
+    int index = acquireShard(tree, data);
+    void *removed = removeFromRBTree(tree->shards[index].tree, data);
+    if (removed != NULL)
+    {
+        // a splitter can only be the lower bound of its own shard (or of empty shards before
+        // it) - it must stay valid until it is replaced.
+        int orphaned = false;
+        for (int i = index - 1; tree->hashFunc == NULL && i >= 0 && tree->splitters[i] == removed;
+             i--)
+        {
+            tree->splitterOrphaned[i] = true;
+            orphaned = true;
+        }
+        if (!orphaned && tree->freeFunc != NULL)
+        {
+            tree->freeFunc(removed);
+        }
+        else if (orphaned && tree->freeFunc == NULL)
+        {
+            // the caller may free a borrowed item as soon as it is deleted.
+            releaseShard(tree, index);
+            replaceSplitter(tree, removed);
+            return true;
+        }
+    }
+    releaseShard(tree, index);
+    return removed != NULL;
+}
+
+/**
+ * @brief check whether the container contains this item.
+ * @param tree: the container to search in.
+ * @param data: item to check.
+ * @return 0 if the item is not in the container, other if it is.
+ */
+int ShardedRBTreeContains(ShardedRBTree *tree, const void *data)
+{
+    if (tree == NULL || data == NULL)
+    {
+        return false;
+    }
+    int index = acquireShard(tree, data);
+    int found = RBTreeContains(tree->shards[index].tree, data);
+    releaseShard(tree, index);
+    return found;
+}
+
+/**
+ * @brief Activate a function on each item of the container, in ascending order over all the
+ * shards. if one of the activations of the function returns 0, the process stops. the container
+ * is locked during the process.
+ * @param tree: the container with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function (may be null if the given function support
+ * it).
+ * @return 0 on failure, other on success.
+ */
+int forEachShardedRBTree(ShardedRBTree *tree, forEachFunc func, void *args)
+{
+    if (tree == NULL || func == NULL)
+    {
+        return false;
+    }
+    Node **cursors = (Node **) malloc(sizeof(Node *) * tree->numShards);
+    if (cursors == NULL)
+    {
+        return false;
+    }
+    pthread_rwlock_rdlock(&tree->splittersLock);
+    // shards are always locked in the same order, so two iterations cannot deadlock.
+    for (int i = 0; i < tree->numShards; i++)
+    {
+        pthread_mutex_lock(&tree->shards[i].lock);
+        cursors[i] = RBTreeFirst(tree->shards[i].tree);
+    }
+    int status = true;
+    if (tree->hashFunc == NULL)
+    {
+        // range shards are ordered - visit them one after the other.
+        for (int i = 0; i < tree->numShards && status; i++)
+        {
+            status = forEachRBTree(tree->shards[i].tree, func, args);
+        }
+    }
+    else
+    {
+        // merge the shards - the number of shards is small, so the smallest cursor is found by a
+        // linear scan.
+        while (status)
+        {
+            int smallest = -1;
+            for (int i = 0; i < tree->numShards; i++)
+            {
+                if (cursors[i] != NULL && (smallest == -1 ||
+                                           tree->compFunc(cursors[i]->data,
+                                                          cursors[smallest]->data) < 0))
+                {
+                    smallest = i;
+                }
+            }
+            if (smallest == -1)
+            {
+                break;
+            }
+            status = func(cursors[smallest]->data, args);
+            cursors[smallest] = RBTreeNext(cursors[smallest]);
+        }
+    }
+    for (int i = tree->numShards - 1; i >= 0; i--)
+    {
+        pthread_mutex_unlock(&tree->shards[i].lock);
+    }
+    pthread_rwlock_unlock(&tree->splittersLock);
+    free(cursors);
+    return status;
+}
+
+/**
+ * @brief moves the smallest or the largest item of one shard to another. the caller holds the
+ * splitters lock for writing.
+ * @param from: the shard to move an item from.
+ * @param to: the shard to move the item to.
+ * @param largest: true to move the largest item of from, false to move the smallest.
+ * @return 0 on failure, other on success.
+ */
+int moveShardItem(Shard *from, Shard *to, int largest)
+{
+    Node *node = from->tree->root;
+    while (largest && node->right != NULL)
+    {
+        node = node->right;
+    }
+    if (!largest)
+    {
+        node = RBTreeFirst(from->tree);
+    }
+    void *item = removeFromRBTree(from->tree, node->data);
+    if (!insertToRBTree(to->tree, item))
+    {
+        insertToRBTree(from->tree, item);
+        return false;
+    }
+    atomic_store(&from->size, from->tree->size);
+    atomic_store(&to->size, to->tree->size);
+    return true;
+}
+
+/**
+ * @brief moves items between neighboring shards of a range-sharded tree so all shards hold about
+ * the same number of items, and moves the split points accordingly. inserts call it
+ * automatically when the shards become skewed.
+ * @param tree: the container.
+ * @return 0 on failure, other on success.
+ */
+int rebalanceShardedRBTree(ShardedRBTree *tree)
+{
+    if (tree == NULL)
+    {
+        return false;
+    }
+    if (tree->hashFunc != NULL)
+    {
+        return true;
+    }
+    pthread_rwlock_wrlock(&tree->splittersLock);
+    long unsigned total = 0, cumulative = 0;
+    for (int i = 0; i < tree->numShards; i++)
+    {
+        total += tree->shards[i].tree->size;
+    }
+    int status = true;
+    for (int i = 0; i < tree->numShards - 1 && status; i++)
+    {
+        // after this boundary is fixed, shards 0..i hold their share of the items.
+        long unsigned target = total * (i + 1) / tree->numShards;
+        cumulative += tree->shards[i].tree->size;
+        while (cumulative > target && status)
+        {
+            status = moveShardItem(&tree->shards[i], &tree->shards[i + 1], true);
+            cumulative--;
+        }
+        int next = i + 1;
+        while (cumulative < target && status)
+        {
+            while (tree->shards[next].tree->size == 0)
+            {
+                next++;
+            }
+            status = moveShardItem(&tree->shards[next], &tree->shards[i], false);
+            cumulative++;
+        }
+    }
+    // the orphaned splitters are replaced now, so they can be freed.
+    for (int i = 0; i < tree->numShards - 1; i++)
+    {
+        if (tree->splitterOrphaned[i] && tree->freeFunc != NULL &&
+            (i + 1 == tree->numShards - 1 || tree->splitters[i + 1] != tree->splitters[i]))
+        {
+            tree->freeFunc(tree->splitters[i]);
+        }
+    }
+    // the splitter of shard i + 1 is the smallest item of the first non-empty shard after i.
+    void *splitter = NULL;
+    for (int i = tree->numShards - 2; i >= 0; i--)
+    {
+        Node *first = RBTreeFirst(tree->shards[i + 1].tree);
+        if (first != NULL)
+        {
+            splitter = first->data;
+        }
+        tree->splitters[i] = splitter;
+        tree->splitterOrphaned[i] = false;
+        tree->splitterSampled[i] = false;
+    }
+    freeArena(&tree->sampleArena);
+    pthread_rwlock_unlock(&tree->splittersLock);
+    return status;
+}
+
+/**
+ * @brief returns the number of items in the container.
+ * @param tree: the container.
+ * @return number of items in the container.
+ */
+long unsigned shardedRBTreeSize(ShardedRBTree *tree)
+{
+    long unsigned total = 0;
+    for (int i = 0; tree != NULL && i < tree->numShards; i++)
+    {
+        total += atomic_load(&tree->shards[i].size);
+    }
+    return total;
+}
+
+/**
+ * @brief free all memory of the data structure. no other thread may use the container during or
+ * after this call.
+ * @param tree: pointer to the container to free.
+ */
+void freeShardedRBTree(ShardedRBTree **tree)
+{
+    if (tree == NULL || *tree == NULL)
+    {
+        return;
+    }
+    ShardedRBTree *sharded = *tree;
+    for (int i = 0; i < sharded->numShards - 1; i++)
+    {
+        if (sharded->splitterOrphaned[i] && sharded->freeFunc != NULL &&
+            (i + 1 == sharded->numShards - 1 || sharded->splitters[i + 1] != sharded->splitters[i]))
+        {
+            sharded->freeFunc(sharded->splitters[i]);
+        }
+    }
+    for (int i = 0; i < sharded->numShards; i++)
+    {
+        freeRBTree(&sharded->shards[i].tree);
+        pthread_mutex_destroy(&sharded->shards[i].lock);
+    }
+    pthread_rwlock_destroy(&sharded->splittersLock);
+    free(sharded->shards);
+    free(sharded->splitters);
+    free(sharded->splitterOrphaned);
+    free(sharded->splitterSampled);
+    freeArena(&sharded->sampleArena);
+    free(sharded);
+    *tree = NULL;
+}
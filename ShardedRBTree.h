@@ -0,0 +1,107 @@
+#ifndef RBTREE_SHARDEDRBTREE_H
+#define RBTREE_SHARDEDRBTREE_H
+
+#include "RBTree.h"
+
+/**
+ * a function to spread the items between the shards of a hash-sharded tree.
+ * @object: a pointer to an item.
+ * @return: the hash of the item. equal items must have equal hashes.
+ */
+typedef unsigned long (*HashFunc)(const void *object);
+
+/**
+ * a container of several RBTrees (shards), each with its own lock, so threads that work on
+ * different shards do not contend. items are spread by key range (ordered shards, with split
+ * points that are rebalanced when the shards' sizes become skewed) or by hash.
+ * all the functions may be called concurrently, except freeShardedRBTree.
+ * ShardedRBTree.c needs C11 (<stdatomic.h>) - the rest of the library builds as C99.
+ */
+typedef struct ShardedRBTree ShardedRBTree;
+
+/**
+ * constructs a new ShardedRBTree.
+ * @param compFunc: a function two compare two variables.
+ * @param freeFunc: a function that frees the items (NULL - the container borrows its items).
+ * @param numShards: number of shards.
+ * @param hashFunc: NULL to shard by key range, otherwise the items are sharded by this hash.
+ * @return a new sharded tree. if creation failed, returns NULL.
+ */
+ShardedRBTree *newShardedRBTree(CompareFunc compFunc, FreeFunc freeFunc, int numShards,
+								HashFunc hashFunc);
+
+/**
+ * sets the split points of a range-sharded tree by the quantiles of a sample of items. with a
+ * RelocateFunc the split points are copies of the sample items, so the sample may be freed as soon
+ * as the call returns. otherwise the sample items are borrowed: each is replaced with the smallest
+ * item of the shard it bounds on the first insert into that shard (or by a rebalance), and must
+ * stay valid until then.
+ * @param tree: an empty range-sharded tree.
+ * @param sample: items that represent the expected distribution of the keys.
+ * @param sampleSize: number of items in sample.
+ * @param relocateFunc: copies an item into an arena (relocateVector, relocateString...), NULL to
+ * borrow the sample items.
+ * @return: 0 on failure, other on success. (if the tree is not empty or sharded by hash - failure).
+ */
+int sampleShardedRBTreeSplitters(ShardedRBTree *tree, void *const *sample, int sampleSize,
+								 RelocateFunc relocateFunc);
+
+/**
+ * add an item to the container.
+ * @param tree: the container to add an item to.
+ * @param data: item to add.
+ * @return: 0 on failure, other on success. (if the item is already in the container - failure).
+ */
+int insertToShardedRBTree(ShardedRBTree *tree, void *data);
+
+/**
+ * remove an item from the container.
+ * @param tree: the container to remove an item from.
+ * @param data: item to remove.
+ * @return: 0 on failure, other on success. (if data is not in the container - failure).
+ */
+int deleteFromShardedRBTree(ShardedRBTree *tree, void *data);
+
+/**
+ * check whether the container contains this item.
+ * @param tree: the container to search in.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the container, other if it is.
+ */
+int ShardedRBTreeContains(ShardedRBTree *tree, const void *data);
+
+/**
+ * Activate a function on each item of the container, in ascending order over all the shards. if
+ * one of the activations of the function returns 0, the process stops. the container is locked
+ * during the process.
+ * @param tree: the container with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function (may be null if the given function support
+ * it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachShardedRBTree(ShardedRBTree *tree, forEachFunc func, void *args);
+
+/**
+ * moves items between neighboring shards of a range-sharded tree so all shards hold about the same
+ * number of items, and moves the split points accordingly. inserts call it automatically when the
+ * shards become skewed.
+ * @param tree: the container.
+ * @return: 0 on failure, other on success.
+ */
+int rebalanceShardedRBTree(ShardedRBTree *tree);
+
+/**
+ * @param tree: the container.
+ * @return: number of items in the container.
+ */
+long unsigned shardedRBTreeSize(ShardedRBTree *tree);
+
+/**
+ * free all memory of the data structure. no other thread may use the container during or after
+ * this call.
+ * @param tree: pointer to the container to free.
+ */
+void freeShardedRBTree(ShardedRBTree **tree);
+
+#endif //RBTREE_SHARDEDRBTREE_H
@@ -0,0 +1,742 @@
+/**
+ * @file SkipList.c
+ * @date 18 october 2026
+ * @brief lock-free skip list (Herlihy-Shavit, with Fraser's fixes for concurrent linking) and the
+ * epoch-based reclamation of its removed nodes.
+*/
+
+#if !defined(__STDC_VERSION__) || __STDC_VERSION__ < 201112L || defined(__STDC_NO_ATOMICS__)
+#error "SkipList.c needs C11 atomics and _Thread_local (compile with -std=c11 or later)"
+#endif
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <limits.h>
+#include "SkipList.h"
+#define MAX_LEVEL 32
+#define MARK ((uintptr_t) 1)
+#define SLOTS_PER_BLOCK 256
+#define RECLAIM_INTERVAL 64
+#define INACTIVE 0
+#define RETIRE_HOLDERS 2
+
+/**
+ * a node of the list. its next pointers carry a mark in their lowest bit - a marked pointer means
+ * the node is (being) removed on that level. retireHolders counts the inserter and the deleter of
+ * the node that are not done with it yet - the last of them retires it, so the inserter can never
+ * link a retired node back in.
+ */
+typedef struct SkipNode
+{
+    void *data;
+    FreeFunc freeFunc;
+    struct SkipNode *retiredNext;
+    unsigned long retiredEpoch;
+    atomic_int retireHolders;
+    int topLevel;
+    _Atomic uintptr_t next[];
+} SkipNode;
+
+/**
+ * represents the list.
+ */
+struct SkipList
+{
+    SkipNode *head;
+    CompareFunc compFunc;
+    FreeFunc freeFunc;
+    atomic_ulong size;
+};
+
+/**
+ * a thread's record in the epoch domain. state is INACTIVE, or (epoch << 1) | 1 while the thread
+ * is inside an operation. limbo holds the nodes the thread retired, and only the owner touches it.
+ */
+typedef struct EpochSlot
+{
+    atomic_ulong state;
+    atomic_int taken;
+    SkipNode *limbo;
+    unsigned long retiredCount;
+    char padding[64];
+} EpochSlot;
+
+/**
+ * a block of the table of the slots. the table grows by blocks that are appended to the last one
+ * and never freed, so a thread can keep a pointer to its slot, and a scan of the table can run
+ * while it grows. the slots of exited threads are reused before a new block is added.
+ */
+typedef struct EpochSlotBlock
+{
+    EpochSlot slots[SLOTS_PER_BLOCK];
+    _Atomic(struct EpochSlotBlock *) next;
+} EpochSlotBlock;
+
+static atomic_ulong globalEpoch = 1;
+static EpochSlotBlock epochSlots;
+static pthread_key_t epochSlotKey;
+static pthread_once_t epochSlotKeyOnce = PTHREAD_ONCE_INIT;
+static _Thread_local EpochSlot *threadSlot = NULL;
+static _Thread_local unsigned int levelSeed = 0;
+// the limbo lists of the threads that exited, reclaimed by the threads that are still running.
+static SkipNode *orphanLimbo = NULL;
+static pthread_mutex_t orphanLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief destructor of a thread's slot - frees the slot for another thread. the nodes in its limbo
+ * list move to the orphans, so they do not wait for the next owner of the slot.
+ * @param pSlot: pointer to the EpochSlot of the exiting thread.
+ */
+void releaseEpochSlot(void *pSlot)
+{
+    EpochSlot *slot = (EpochSlot *) pSlot;
+    atomic_store(&slot->state, INACTIVE);
+    if (slot->limbo != NULL)
+    {
+        SkipNode *last = slot->limbo;
+        while (last->retiredNext != NULL)
+        {
+            last = last->retiredNext;
+        }
+        pthread_mutex_lock(&orphanLock);
+        last->retiredNext = orphanLimbo;
+        orphanLimbo = slot->limbo;
+        pthread_mutex_unlock(&orphanLock);
+        slot->limbo = NULL;
+    }
+    slot->retiredCount = 0;
+    atomic_store(&slot->taken, false);
+}
+
+/**
+ * @brief creates the key that releases the slots of exiting threads.
+ */
+void createEpochSlotKey(void)
+{
+    pthread_key_create(&epochSlotKey, releaseEpochSlot);
+}
+
+/**
+ * @brief returns the slot of the calling thread, claims one on the first call - a free slot of
+ * the table, or one of a new block when all are taken.
+ * @return the slot, NULL on failure (no memory for a new block).
+ */
+EpochSlot *getEpochSlot(void)
+{
+    if (threadSlot != NULL)
+    {
+        return threadSlot;
+    }
+    pthread_once(&epochSlotKeyOnce, createEpochSlotKey);
+    EpochSlotBlock *block = &epochSlots;
+    while (true)
+    {
+        for (int i = 0; i < SLOTS_PER_BLOCK; i++)
+        {
+            int expected = false;
+            if (atomic_compare_exchange_strong(&block->slots[i].taken, &expected, true))
+            {
+                threadSlot = &block->slots[i];
+                pthread_setspecific(epochSlotKey, threadSlot);
+                return threadSlot;
+            }
+        }
+        EpochSlotBlock *next = atomic_load(&block->next);
+        if (next == NULL)
+        {
+            EpochSlotBlock *grown = (EpochSlotBlock *) calloc(1, sizeof(EpochSlotBlock));
+            if (grown == NULL)
+            {
+                return NULL;
+            }
+            // another thread may append its block first - then use that one.
+            if (atomic_compare_exchange_strong(&block->next, &next, grown))
+            {
+                next = grown;
+            }
+            else
+            {
+                free(grown);
+            }
+        }
+        block = next;
+    }
+}
+
+/**
+ * @brief announces that the calling thread starts reading the list in the current epoch.
+ * @return the slot of the thread, NULL on failure (no memory for a slot).
+ */
+EpochSlot *enterEpoch(void)
+{
+    EpochSlot *slot = getEpochSlot();
+    if (slot == NULL)
+    {
+        return NULL;
+    }
+    unsigned long epoch;
+    // re-announce until the epoch did not advance in between, so no reclaimer missed us.
+    do
+    {
+        epoch = atomic_load(&globalEpoch);
+        atomic_store(&slot->state, (epoch << 1) | 1);
+    } while (atomic_load(&globalEpoch) != epoch);
+    return slot;
+}
+
+/**
+ * @brief announces that the calling thread stopped reading the list.
+ * @param slot: the slot of the thread.
+ */
+void exitEpoch(EpochSlot *slot)
+{
+    atomic_store(&slot->state, INACTIVE);
+}
+
+/**
+ * @brief advances the global epoch if every thread inside an operation already announced it.
+ */
+void tryAdvanceEpoch(void)
+{
+    unsigned long epoch = atomic_load(&globalEpoch);
+    for (EpochSlotBlock *block = &epochSlots; block != NULL; block = atomic_load(&block->next))
+    {
+        for (int i = 0; i < SLOTS_PER_BLOCK; i++)
+        {
+            unsigned long state = atomic_load(&block->slots[i].state);
+            if (state != INACTIVE && (state >> 1) != epoch)
+            {
+                return;
+            }
+        }
+    }
+    atomic_compare_exchange_strong(&globalEpoch, &epoch, epoch + 1);
+}
+
+/**
+ * @brief frees the nodes of a limbo list that were retired at least two epochs before a given
+ * epoch.
+ * @param limbo: pointer to the first node of the list.
+ * @param epoch: the epoch (ULONG_MAX - all the nodes).
+ */
+void reclaimList(SkipNode **limbo, unsigned long epoch)
+{
+    SkipNode **link = limbo;
+    while (*link != NULL)
+    {
+        SkipNode *node = *link;
+        if (node->retiredEpoch + 2 <= epoch || epoch == ULONG_MAX)
+        {
+            *link = node->retiredNext;
+            if (node->freeFunc != NULL)
+            {
+                node->freeFunc(node->data);
+            }
+            free(node);
+        }
+        else
+        {
+            link = &node->retiredNext;
+        }
+    }
+}
+
+/**
+ * @brief frees the nodes of the slot's limbo list, and of the orphans, that were retired at least
+ * two epochs ago - no thread can still hold a pointer to them.
+ * @param slot: the slot of the calling thread.
+ */
+void reclaimLimbo(EpochSlot *slot)
+{
+    unsigned long epoch = atomic_load(&globalEpoch);
+    reclaimList(&slot->limbo, epoch);
+    // the orphans are best effort - another thread reclaiming them is as good.
+    if (pthread_mutex_trylock(&orphanLock) == 0)
+    {
+        reclaimList(&orphanLimbo, epoch);
+        pthread_mutex_unlock(&orphanLock);
+    }
+}
+
+/**
+ * @brief hands an unlinked node to the reclamation.
+ * @param slot: the slot of the calling thread.
+ * @param node: the node, already unreachable for threads that start an operation from now on.
+ */
+void retireNode(EpochSlot *slot, SkipNode *node)
+{
+    node->retiredEpoch = atomic_load(&globalEpoch);
+    node->retiredNext = slot->limbo;
+    slot->limbo = node;
+    if (++slot->retiredCount % RECLAIM_INTERVAL == 0)
+    {
+        tryAdvanceEpoch();
+        reclaimLimbo(slot);
+    }
+}
+
+/**
+ * @brief creates a new node.
+ * @param data: node's data.
+ * @param topLevel: highest level of the node.
+ * @return the new node, NULL on failure.
+ */
+SkipNode *newSkipNode(void *data, int topLevel)
+{
+    SkipNode *node = (SkipNode *) calloc(1, sizeof(SkipNode) +
+                                            sizeof(_Atomic uintptr_t) * (topLevel + 1));
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    node->data = data;
+    node->topLevel = topLevel;
+    atomic_init(&node->retireHolders, RETIRE_HOLDERS);
+    return node;
+}
+
+/**
+ * @brief called by the inserter and by the deleter of a node once they are done with it - the
+ * second of them retires the node.
+ * @param slot: the slot of the calling thread.
+ * @param node: the node, unlinked from all levels as far as the caller is concerned.
+ */
+void releaseRetireHolder(EpochSlot *slot, SkipNode *node)
+{
+    if (atomic_fetch_sub(&node->retireHolders, 1) == 1)
+    {
+        retireNode(slot, node);
+    }
+}
+
+/**
+ * @brief draws the top level of a new node - level i with probability 2^-(i+1).
+ * @return a level in [0, MAX_LEVEL).
+ */
+int randomLevel(void)
+{
+    if (levelSeed == 0)
+    {
+        // seed from the address of a thread-local, so every thread draws a different sequence.
+        levelSeed = (unsigned int) (uintptr_t) &levelSeed | 1;
+    }
+    // xorshift32
+    levelSeed ^= levelSeed << 13;
+    levelSeed ^= levelSeed >> 17;
+    levelSeed ^= levelSeed << 5;
+    int level = 0;
+    unsigned int bits = levelSeed;
+    while ((bits & 1) && level < MAX_LEVEL - 1)
+    {
+        level++;
+        bits >>= 1;
+    }
+    return level;
+}
+
+/**
+ * @brief gets the node of a (possibly marked) next pointer.
+ */
+SkipNode *unmarked(uintptr_t next)
+{
+    return (SkipNode *) (next & ~MARK);
+}
+
+/**
+ * @brief finds, on every level, the last node smaller than data (preds) and the first node that
+ * is not smaller (succs). unlinks marked nodes it passes on the way.
+ * @param list: the list.
+ * @param data: item to search.
+ * @param preds, succs: arrays of MAX_LEVEL nodes to fill.
+ * @return true if succs[0] holds an item equal to data.
+ */
+int findInSkipList(const SkipList *list, const void *data, SkipNode **preds, SkipNode **succs)
+{
+retry:
+    {
+        SkipNode *pred = list->head;
+        SkipNode *curr = NULL;
+        for (int level = MAX_LEVEL - 1; level >= 0; level--)
+        {
+            curr = unmarked(atomic_load(&pred->next[level]));
+            while (curr != NULL)
+            {
+                uintptr_t succ = atomic_load(&curr->next[level]);
+                while (succ & MARK)
+                {
+                    // curr is removed - snip it out of this level.
+                    uintptr_t expected = (uintptr_t) curr;
+                    if (!atomic_compare_exchange_strong(&pred->next[level], &expected,
+                                                        (uintptr_t) unmarked(succ)))
+                    {
+                        goto retry;
+                    }
+                    curr = unmarked(succ);
+                    if (curr == NULL)
+                    {
+                        break;
+                    }
+                    succ = atomic_load(&curr->next[level]);
+                }
+                if (curr == NULL || list->compFunc(curr->data, data) >= 0)
+                {
+                    break;
+                }
+                pred = curr;
+                curr = unmarked(succ);
+            }
+            preds[level] = pred;
+            succs[level] = curr;
+        }
+        return curr != NULL && list->compFunc(curr->data, data) == 0;
+    }
+}
+
+/**
+ * @brief constructs a new SkipList with the given CompareFunc.
+ * @param compFunc: a function two compare two variables.
+ * @param freeFunc: a function that frees the items (NULL - the list borrows its items).
+ * @return a new skip list. if creation failed, returns NULL.
+ */
+SkipList *newSkipList(CompareFunc compFunc, FreeFunc freeFunc)
+{
+    if (compFunc == NULL)
+    {
+        return NULL;
+    }
+    SkipList *list = (SkipList *) calloc(1, sizeof(SkipList));
+    if (list == NULL)
+    {
+        return NULL;
+    }
+    list->head = newSkipNode(NULL, MAX_LEVEL - 1);
+    if (list->head == NULL)
+    {
+        free(list);
+        return NULL;
+    }
+    list->compFunc = compFunc;
+    list->freeFunc = freeFunc;
+    atomic_init(&list->size, 0);
+    return list;
+}
+
+/**
+ * @brief links a new node, that is already linked on level 0, on its upper levels. stops if the
+ * node is removed concurrently.
+ * @param list: the list.
+ * @param node: the node.
+ * @param preds, succs: the result of the last search for the node's data.
+ */
+void linkUpperLevels(SkipList *list, SkipNode *node, SkipNode **preds, SkipNode **succs)
+{
+    for (int level = 1; level <= node->topLevel; level++)
+    {
+        while (true)
+        {
+            SkipNode *pred = preds[level];
+            SkipNode *succ = succs[level];
+            uintptr_t next = atomic_load(&node->next[level]);
+            if (next & MARK)
+            {
+                return;
+            }
+            if (unmarked(next) != succ &&
+                !atomic_compare_exchange_strong(&node->next[level], &next, (uintptr_t) succ))
+            {
+                // the node was marked in between.
+                return;
+            }
+            uintptr_t expected = (uintptr_t) succ;
+            if (atomic_compare_exchange_strong(&pred->next[level], &expected, (uintptr_t) node))
+            {
+                break;
+            }
+            if (!findInSkipList(list, node->data, preds, succs) || succs[0] != node)
+            {
+                // the node was removed in between.
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * @brief add an item to the list
+ * @param list: the list to add an item to.
+ * @param data: item to add to the list.
+ * @return 0 on failure, other on success. (if the item is already in the list - failure).
+ */
+int insertToSkipList(SkipList *list, void *data)
+{
+    if (list == NULL || data == NULL)
+    {
+        return false;
+    }
+    EpochSlot *slot = enterEpoch();
+    if (slot == NULL)
+    {
+        return false;
+    }
+    SkipNode *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+    SkipNode *node = NULL;
+    while (true)
+    {
+        if (findInSkipList(list, data, preds, succs))
+        {
+            free(node);
+            exitEpoch(slot);
+            return false;
+        }
+        if (node == NULL)
+        {
+            node = newSkipNode(data, randomLevel());
+            if (node == NULL)
+            {
+                exitEpoch(slot);
+                return false;
+            }
+            node->freeFunc = list->freeFunc;
+        }
+        for (int level = 0; level <= node->topLevel; level++)
+        {
+            atomic_store(&node->next[level], (uintptr_t) succs[level]);
+        }
+        // linking level 0 is the linearization point of the insertion.
+        uintptr_t expected = (uintptr_t) succs[0];
+        if (atomic_compare_exchange_strong(&preds[0]->next[0], &expected, (uintptr_t) node))
+        {
+            break;
+        }
+    }
+    atomic_fetch_add(&list->size, 1);
+    linkUpperLevels(list, node, preds, succs);
+    if (atomic_load(&node->next[0]) & MARK)
+    {
+        // removed while we were linking it - make sure no level still points to it.
+        findInSkipList(list, data, preds, succs);
+    }
+    releaseRetireHolder(slot, node);
+    exitEpoch(slot);
+    return true;
+}
+
+/**
+ * @brief remove an item from the list
+ * @param list: the list to remove an item from.
+ * @param data: item to remove from the list.
+ * @return 0 on failure, other on success. (if data is not in the list - failure).
+ */
+int deleteFromSkipList(SkipList *list, void *data)
+{
+    if (list == NULL || data == NULL)
+    {
+        return false;
+    }
+    EpochSlot *slot = enterEpoch();
+    if (slot == NULL)
+    {
+        return false;
+    }
+    SkipNode *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+    if (!findInSkipList(list, data, preds, succs))
+    {
+        exitEpoch(slot);
+        return false;
+    }
+    SkipNode *node = succs[0];
+    // mark the upper levels top-down, then level 0.
+    for (int level = node->topLevel; level >= 1; level--)
+    {
+        uintptr_t next = atomic_load(&node->next[level]);
+        while (!(next & MARK) &&
+               !atomic_compare_exchange_weak(&node->next[level], &next, next | MARK))
+        {
+        }
+    }
+    uintptr_t next = atomic_load(&node->next[0]);
+    while (true)
+    {
+        if (next & MARK)
+        {
+            // another thread removed it first.
+            exitEpoch(slot);
+            return false;
+        }
+        // marking level 0 is the linearization point of the removal.
+        if (atomic_compare_exchange_weak(&node->next[0], &next, next | MARK))
+        {
+            break;
+        }
+    }
+    atomic_fetch_sub(&list->size, 1);
+    // unlink it from all levels. it is retired once its inserter is done linking it too.
+    findInSkipList(list, data, preds, succs);
+    releaseRetireHolder(slot, node);
+    exitEpoch(slot);
+    return true;
+}
+
+/**
+ * @brief check whether the list contains this item.
+ * @param list: the list to search in.
+ * @param data: item to check.
+ * @return 0 if the item is not in the list, other if it is.
+ */
+int SkipListContains(const SkipList *list, const void *data)
+{
+    if (list == NULL || data == NULL)
+    {
+        return false;
+    }
+    EpochSlot *slot = enterEpoch();
+    if (slot == NULL)
+    {
+        return false;
+    }
+    // a wait-free search - marked nodes are skipped instead of unlinked.
+    SkipNode *pred = list->head;
+    SkipNode *curr = NULL;
+    int found = false;
+    for (int level = MAX_LEVEL - 1; level >= 0 && !found; level--)
+    {
+        curr = unmarked(atomic_load(&pred->next[level]));
+        while (curr != NULL)
+        {
+            uintptr_t succ = atomic_load(&curr->next[level]);
+            if (succ & MARK)
+            {
+                curr = unmarked(succ);
+                continue;
+            }
+            int comparison = list->compFunc(curr->data, data);
+            if (comparison < 0)
+            {
+                pred = curr;
+                curr = unmarked(succ);
+            }
+            else
+            {
+                found = comparison == 0 && !(atomic_load(&curr->next[0]) & MARK);
+                break;
+            }
+        }
+    }
+    exitEpoch(slot);
+    return found;
+}
+
+/**
+ * @brief Activate a function on each item of the list, in ascending order. if one of the
+ * activations of the function returns 0, the process stops. items inserted or removed
+ * concurrently may or may not be visited.
+ * @param list: the list with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function (may be null if the given function support
+ * it).
+ * @return 0 on failure, other on success.
+ */
+int forEachSkipList(const SkipList *list, forEachFunc func, void *args)
+{
+    if (list == NULL || func == NULL)
+    {
+        return false;
+    }
+    EpochSlot *slot = enterEpoch();
+    if (slot == NULL)
+    {
+        return false;
+    }
+    int status = true;
+    SkipNode *curr = unmarked(atomic_load(&list->head->next[0]));
+    while (curr != NULL && status)
+    {
+        uintptr_t next = atomic_load(&curr->next[0]);
+        if (!(next & MARK))
+        {
+            status = func(curr->data, args);
+        }
+        curr = unmarked(next);
+    }
+    exitEpoch(slot);
+    return status;
+}
+
+/**
+ * @brief returns the number of items in the list.
+ * @param list: the list.
+ * @return number of items in the list.
+ */
+long unsigned skipListSize(const SkipList *list)
+{
+    return list == NULL ? 0 : atomic_load(&list->size);
+}
+
+/**
+ * @brief frees the removed nodes of all the skip lists, and their items - the ones retired by the
+ * calling thread, by threads that exited, and by threads that are idle.
+ */
+void reclaimSkipListMemory(void)
+{
+    for (EpochSlotBlock *block = &epochSlots; block != NULL; block = atomic_load(&block->next))
+    {
+        for (int i = 0; i < SLOTS_PER_BLOCK; i++)
+        {
+            reclaimList(&block->slots[i].limbo, ULONG_MAX);
+        }
+    }
+    pthread_mutex_lock(&orphanLock);
+    reclaimList(&orphanLimbo, ULONG_MAX);
+    pthread_mutex_unlock(&orphanLock);
+}
+
+/**
+ * @brief frees the removed nodes the calling thread can free now - its own and the orphans,
+ * retired two epochs ago. the epoch is advanced first, as far as the other threads allow.
+ */
+void reclaimOwnLimbo(void)
+{
+    EpochSlot *slot = getEpochSlot();
+    if (slot == NULL)
+    {
+        return;
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        tryAdvanceEpoch();
+    }
+    reclaimLimbo(slot);
+}
+
+/**
+ * @brief free all memory of the data structure. no other thread may use the list during or after
+ * this call.
+ * @param list: pointer to the list to free.
+ */
+void freeSkipList(SkipList **list)
+{
+    if (list == NULL || *list == NULL)
+    {
+        return;
+    }
+    // every node still linked on level 0 is owned by the list - removed nodes are in limbo lists.
+    SkipNode *curr = (*list)->head;
+    while (curr != NULL)
+    {
+        SkipNode *next = unmarked(atomic_load(&curr->next[0]));
+        if (curr != (*list)->head && (*list)->freeFunc != NULL)
+        {
+            (*list)->freeFunc(curr->data);
+        }
+        free(curr);
+        curr = next;
+    }
+    free(*list);
+    *list = NULL;
+    // the removed nodes of the list - unless other threads are still inside operations on other
+    // lists, this frees all the ones of the calling thread and of the threads that exited.
+    reclaimOwnLimbo();
+}
@@ -0,0 +1,83 @@
+#ifndef RBTREE_SKIPLIST_H
+#define RBTREE_SKIPLIST_H
+
+#include "RBTree.h"
+
+/**
+ * a lock-free skip list with the same surface as RBTree, for workloads with many concurrent
+ * writers. all the functions may be called concurrently from any number of threads, except
+ * freeSkipList. removed items are freed by their FreeFunc only once no thread can still be
+ * reading them (epoch-based reclamation). every thread claims a slot of the reclamation on its
+ * first call - the table of the slots grows with the threads, so an operation fails for lack of
+ * memory only, never for the number of threads.
+ * SkipList.c needs C11 (<stdatomic.h> and _Thread_local) - the rest of the library builds as C99.
+ */
+typedef struct SkipList SkipList;
+
+/**
+ * constructs a new SkipList with the given CompareFunc.
+ * @param compFunc: a function two compare two variables.
+ * @param freeFunc: a function that frees the items (NULL - the list borrows its items).
+ * @return a new skip list. if creation failed, returns NULL.
+ */
+SkipList *newSkipList(CompareFunc compFunc, FreeFunc freeFunc);
+
+/**
+ * add an item to the list
+ * @param list: the list to add an item to.
+ * @param data: item to add to the list.
+ * @return: 0 on failure, other on success. (if the item is already in the list - failure).
+ */
+int insertToSkipList(SkipList *list, void *data);
+
+/**
+ * remove an item from the list
+ * @param list: the list to remove an item from.
+ * @param data: item to remove from the list.
+ * @return: 0 on failure, other on success. (if data is not in the list - failure).
+ */
+int deleteFromSkipList(SkipList *list, void *data);
+
+/**
+ * check whether the list contains this item.
+ * @param list: the list to search in.
+ * @param data: item to check.
+ * @return: 0 if the item is not in the list, other if it is.
+ */
+int SkipListContains(const SkipList *list, const void *data);
+
+/**
+ * Activate a function on each item of the list, in ascending order. if one of the activations of
+ * the function returns 0, the process stops. items inserted or removed concurrently may or may
+ * not be visited.
+ * @param list: the list with all the items.
+ * @param func: the function to activate on all items.
+ * @param args: more optional arguments to the function (may be null if the given function support
+ * it).
+ * @return: 0 on failure, other on success.
+ */
+int forEachSkipList(const SkipList *list, forEachFunc func, void *args);
+
+/**
+ * @param list: the list.
+ * @return: number of items in the list.
+ */
+long unsigned skipListSize(const SkipList *list);
+
+/**
+ * free all memory of the data structure. no other thread may use the list during or after this
+ * call. removed items the calling thread and exited threads retired are freed too, as soon as no
+ * thread is inside an operation on any list - the ones of threads that are still running wait
+ * for those threads (or for reclaimSkipListMemory).
+ * @param list: pointer to the list to free.
+ */
+void freeSkipList(SkipList **list);
+
+/**
+ * frees the removed items of all the skip lists that are still waiting to be reclaimed (of every
+ * thread). a quiescent drain: no thread may be inside an operation on any skip list during this
+ * call - for example at shutdown, after the worker threads were joined.
+ */
+void reclaimSkipListMemory(void);
+
+#endif //RBTREE_SKIPLIST_H
@@ -12,6 +12,12 @@
 #include <stdbool.h>
 #include <math.h>
 #include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define SIMD_BLOCK 16
+#endif
 #define LESS (-1)
 #define EQUAL (0)
 #define GREATER (1)
@@ -145,22 +151,113 @@ Vector *findMaxNormVectorInTree(RBTree *tree) // implement it in Structs.c You m
     return res;
 }
 
+/**
+ * the state of a search for the vector with the largest norm, without copies.
+ */
+typedef struct MaxNormSearch
+{
+    const Vector *max;
+    double norm;
+} MaxNormSearch;
+
+/**
+ * ForEach function that keeps a pointer to pVector if its norm is larger than the norm of the
+ * vector kept in pSearch (or if no vector is kept).
+ * @param pVector pointer to Vector
+ * @param pSearch pointer to MaxNormSearch
+ * @return 1 on success, 0 on failure (if pVector == NULL: failure).
+ */
+int keepIfNormIsLarger(const void *pVector, void *pSearch)
+{
+    const Vector *vector = (const Vector *) pVector;
+    MaxNormSearch *search = (MaxNormSearch *) pSearch;
+    if (vector == NULL || search == NULL)
+    {
+        return false;
+    }
+    if (vector->vector != NULL && vector->len > 0)
+    {
+        double norm = getNorm(vector);
+        if (search->max == NULL || norm > search->norm)
+        {
+            search->max = vector;
+            search->norm = norm;
+        }
+    }
+    return true;
+}
+
+/**
+ * @param tree a pointer to a tree of Vectors
+ * @return pointer to the vector that has the largest norm (L2 Norm), borrowed from the tree (no
+ * copy is made). NULL if the tree is empty.
+ */
+const Vector *peekMaxNormVectorInTree(const RBTree *tree)
+{
+    MaxNormSearch search = {NULL, 0};
+    if (tree == NULL || !forEachRBTree(tree, keepIfNormIsLarger, &search))
+    {
+        return NULL;
+    }
+    return search.max;
+}
+
 /**
  * FreeFunc for vectors
  */
 void freeVector(void *pVector) // implement it in Structs.c
 {
     Vector *v = (Vector *) pVector;
-    if (v == NULL || v->len == 0)
+    if (v == NULL)
     {
         return;
     }
-    else
+    free(v->vector);
+    v->vector = NULL;
+    free(v);
+}
+
+/**
+ * SizeFunc for vectors
+ * @param pVector pointer to Vector
+ * @return number of bytes of the vector and its elements.
+ */
+size_t vectorSize(const void *pVector)
+{
+    const Vector *v = (const Vector *) pVector;
+    return v == NULL ? 0 : sizeof(Vector) + (size_t) v->len * sizeof(double);
+}
+
+/**
+ * RelocateFunc for vectors - copies the vector and its elements into the arena.
+ * @param pVector pointer to Vector
+ * @param arena the arena to allocate the copy from.
+ * @return pointer to the copy, NULL on failure.
+ */
+void *relocateVector(const void *pVector, Arena *arena)
+{
+    const Vector *v = (const Vector *) pVector;
+    if (v == NULL)
     {
-        free(v->vector);
-        v->vector = NULL;
+        return NULL;
     }
-    free(v);
+    Vector *copy = (Vector *) arenaAlloc(arena, sizeof(Vector));
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+    copy->len = v->len;
+    copy->vector = NULL;
+    if (v->len > 0)
+    {
+        copy->vector = (double *) arenaAlloc(arena, (size_t) v->len * sizeof(double));
+        if (copy->vector == NULL)
+        {
+            return NULL;
+        }
+        memcpy(copy->vector, v->vector, (size_t) v->len * sizeof(double));
+    }
+    return copy;
 }
 
 /**
@@ -177,6 +274,59 @@ int stringCompare(const void *a, const void *b) // implement it in Structs.c
     return strcmp(c1, c2);
 }
 
+/**
+ * KeyPrefixFunc for strings - the first 8 bytes, packed big-endian.
+ * @param s - char* pointer
+ * @return the prefix of the string.
+ */
+unsigned long long stringKeyPrefix(const void *s)
+{
+    const unsigned char *c = (const unsigned char *) s;
+    unsigned long long prefix = 0;
+    int i = 0;
+    // strcmp compares unsigned bytes, and a string is smaller than its extensions - so padding
+    // with zeros keeps the order.
+    for (; i < 8 && c[i] != '\0'; i++)
+    {
+        prefix = (prefix << 8) | c[i];
+    }
+    return i == 0 ? 0 : prefix << (8 * (8 - i));
+}
+
+/**
+ * @brief maps a double to an unsigned integer with the same order: flips all the bits of negative
+ * numbers, and only the sign bit of the others.
+ * @param d: the double (not NaN).
+ * @return the sortable encoding of d. all encodings are greater than 0.
+ */
+unsigned long long sortableDouble(double d)
+{
+    if (d == 0)
+    {
+        // -0.0 == 0.0, so they must map to the same key.
+        d = 0;
+    }
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    return (bits >> 63) ? ~bits : bits | ((uint64_t) 1 << 63);
+}
+
+/**
+ * KeyPrefixFunc for vectors - an order-preserving encoding of the first element.
+ * @param pVector - pointer to Vector
+ * @return the prefix of the vector.
+ */
+unsigned long long vectorKeyPrefix(const void *pVector)
+{
+    const Vector *vector = (const Vector *) pVector;
+    if (vector == NULL || vector->len <= 0 || vector->vector == NULL)
+    {
+        // empty vectors are smaller than all others.
+        return 0;
+    }
+    return sortableDouble(vector->vector[0]);
+}
+
 /**
  * ForEach function that concatenates the given word and \n to pConcatenated. pConcatenated is
  * already allocated with enough space.
@@ -207,4 +357,1402 @@ void freeString(void *s) // implement it in Structs.c
     {
         free((char*) s);
     }
-}
\ No newline at end of file
+}
+
+/**
+ * SizeFunc for strings
+ * @param s char* pointer
+ * @return number of bytes of the string, with its "\0".
+ */
+size_t stringSize(const void *s)
+{
+    return s == NULL ? 0 : strlen((const char *) s) + 1;
+}
+
+/**
+ * RelocateFunc for strings - copies the string into the arena.
+ * @param s char* pointer
+ * @param arena the arena to allocate the copy from.
+ * @return pointer to the copy, NULL on failure.
+ */
+void *relocateString(const void *s, Arena *arena)
+{
+    if (s == NULL)
+    {
+        return NULL;
+    }
+    size_t size = strlen((const char *) s) + 1;
+    char *copy = (char *) arenaAlloc(arena, size);
+    if (copy != NULL)
+    {
+        memcpy(copy, s, size);
+    }
+    return copy;
+}
+
+//-------------- strings with lengths. ----------------
+
+/**
+ * @brief creates a LenString, as a single allocation.
+ * @param chars the bytes of the string (copied).
+ * @param len number of bytes.
+ * @return the new string, NULL on failure.
+ */
+LenString *newLenString(const char *chars, size_t len)
+{
+    if (chars == NULL && len > 0)
+    {
+        return NULL;
+    }
+    LenString *string = (LenString *) malloc(sizeof(LenString) + len + 1);
+    if (string == NULL)
+    {
+        return NULL;
+    }
+    string->len = len;
+    string->chars = (char *) (string + 1);
+    if (len > 0)
+    {
+        memcpy(string->chars, chars, len);
+    }
+    string->chars[len] = '\0';
+    return string;
+}
+
+/**
+ * CompFunc for LenStrings
+ * @param a LenString* pointer
+ * @param b LenString* pointer
+ * @return equal to 0 iff a == b. lower than 0 if a < b. Greater than 0 iff b < a.
+ */
+int lenStringCompare(const void *a, const void *b)
+{
+    const LenString *s1 = (const LenString *) a;
+    const LenString *s2 = (const LenString *) b;
+    // memcmp is vectorized by the C library, and needs no "\0" scan.
+    int comparison = memcmp(s1->chars, s2->chars, s1->len < s2->len ? s1->len : s2->len);
+    if (comparison != 0)
+    {
+        return comparison;
+    }
+    return (s1->len > s2->len) - (s1->len < s2->len);
+}
+
+/**
+ * @brief the length of the common prefix of two byte arrays, from a known common prefix on.
+ * @param a first array.
+ * @param b second array.
+ * @param from number of leading bytes known to be equal.
+ * @param len number of bytes of the shorter array.
+ * @return the index of the first different byte, len if there is none.
+ */
+size_t commonPrefixLength(const char *a, const char *b, size_t from, size_t len)
+{
+    size_t i = from;
+#ifdef SIMD_BLOCK
+    for (; i + SIMD_BLOCK <= len; i += SIMD_BLOCK)
+    {
+        __m128i block1 = _mm_loadu_si128((const __m128i *) (a + i));
+        __m128i block2 = _mm_loadu_si128((const __m128i *) (b + i));
+        // a bit per byte, set where the bytes differ.
+        unsigned int differ = ~(unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(block1, block2)) &
+                              0xFFFFu;
+        if (differ != 0)
+        {
+            return i + (size_t) __builtin_ctz(differ);
+        }
+    }
+    if (i < len && len >= SIMD_BLOCK)
+    {
+        // the last block ends at len, and overlaps bytes that are already known to be equal.
+        size_t last = len - SIMD_BLOCK;
+        __m128i block1 = _mm_loadu_si128((const __m128i *) (a + last));
+        __m128i block2 = _mm_loadu_si128((const __m128i *) (b + last));
+        unsigned int differ = ~(unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(block1, block2)) &
+                              0xFFFFu;
+        return differ == 0 ? len : last + (size_t) __builtin_ctz(differ);
+    }
+#endif
+    while (i < len && a[i] == b[i])
+    {
+        i++;
+    }
+    return i;
+}
+
+/**
+ * LcpCompareFunc for LenStrings
+ * @param a LenString* pointer
+ * @param b LenString* pointer
+ * @param skip number of leading bytes known to be equal.
+ * @param lcp set to the length of the common prefix of a and b.
+ * @return equal to 0 iff a == b. lower than 0 if a < b. Greater than 0 iff b < a.
+ */
+int lenStringLcpCompare(const void *a, const void *b, size_t skip, size_t *lcp)
+{
+    const LenString *s1 = (const LenString *) a;
+    const LenString *s2 = (const LenString *) b;
+    size_t shorter = s1->len < s2->len ? s1->len : s2->len;
+    size_t i = commonPrefixLength(s1->chars, s2->chars, skip < shorter ? skip : shorter, shorter);
+    *lcp = i;
+    if (i < shorter)
+    {
+        return (unsigned char) s1->chars[i] < (unsigned char) s2->chars[i] ? LESS : GREATER;
+    }
+    return (s1->len > s2->len) - (s1->len < s2->len);
+}
+
+/**
+ * KeyPrefixFunc for LenStrings - the first 8 bytes, packed big-endian.
+ * @param s LenString* pointer
+ * @return the prefix of the string.
+ */
+unsigned long long lenStringKeyPrefix(const void *s)
+{
+    const LenString *string = (const LenString *) s;
+    unsigned long long prefix = 0;
+    // as in stringKeyPrefix, padding with zeros keeps the order.
+    for (size_t i = 0; i < 8; i++)
+    {
+        prefix = (prefix << 8) | (i < string->len ? (unsigned char) string->chars[i] : 0);
+    }
+    return prefix;
+}
+
+/**
+ * FreeFunc for LenStrings
+ * @param s LenString* pointer
+ */
+void freeLenString(void *s)
+{
+    free(s);
+}
+
+/**
+ * SizeFunc for LenStrings
+ * @param s LenString* pointer
+ * @return number of bytes of the string, with its struct and its "\0".
+ */
+size_t lenStringSize(const void *s)
+{
+    return s == NULL ? 0 : sizeof(LenString) + ((const LenString *) s)->len + 1;
+}
+
+/**
+ * RelocateFunc for LenStrings - copies the string into the arena.
+ * @param s LenString* pointer
+ * @param arena the arena to allocate the copy from.
+ * @return pointer to the copy, NULL on failure.
+ */
+void *relocateLenString(const void *s, Arena *arena)
+{
+    if (s == NULL)
+    {
+        return NULL;
+    }
+    const LenString *string = (const LenString *) s;
+    LenString *copy = (LenString *) arenaAlloc(arena, sizeof(LenString) + string->len + 1);
+    if (copy != NULL)
+    {
+        copy->len = string->len;
+        copy->chars = (char *) (copy + 1);
+        memcpy(copy->chars, string->chars, string->len + 1);
+    }
+    return copy;
+}
+
+//-------------- spatial index (KD-tree) over vectors. ----------------
+
+/**
+ * an item of a bounded heap - a vector and the key it is ordered by.
+ */
+typedef struct VectorHeapItem
+{
+    double key;
+    const Vector *vector;
+} VectorHeapItem;
+
+/**
+ * @brief pushes an item to a bounded min-heap that keeps the capacity items with the largest
+ * keys (the root is the smallest key kept).
+ * @param heap: the heap array (of at least capacity items).
+ * @param size: pointer to the current number of items in the heap.
+ * @param capacity: maximal number of items in the heap.
+ * @param key: the key of the new item.
+ * @param vector: the vector of the new item.
+ */
+void pushToBoundedHeap(VectorHeapItem *heap, int *size, int capacity, double key,
+                       const Vector *vector)
+{
+    int i;
+    if (*size < capacity)
+    {
+        // sift up from the new leaf.
+        i = (*size)++;
+        while (i > 0 && heap[(i - 1) / 2].key > key)
+        {
+            heap[i] = heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        heap[i].key = key;
+        heap[i].vector = vector;
+        return;
+    }
+    if (capacity == 0 || key <= heap[0].key)
+    {
+        return;
+    }
+    // replace the root and sift down.
+    i = 0;
+    while (true)
+    {
+        int child = 2 * i + 1;
+        if (child >= *size)
+        {
+            break;
+        }
+        if (child + 1 < *size && heap[child + 1].key < heap[child].key)
+        {
+            child++;
+        }
+        if (heap[child].key >= key)
+        {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i].key = key;
+    heap[i].vector = vector;
+}
+
+/**
+ * @brief empties a bounded heap into an array, sorted by descending key.
+ * @param heap: the heap array.
+ * @param size: number of items in the heap.
+ * @param out: array of at least size pointers.
+ */
+void popBoundedHeapSorted(VectorHeapItem *heap, int size, const Vector **out)
+{
+    while (size > 0)
+    {
+        // the root is the smallest key - it goes to the end.
+        out[size - 1] = heap[0].vector;
+        VectorHeapItem last = heap[--size];
+        int i = 0;
+        while (true)
+        {
+            int child = 2 * i + 1;
+            if (child >= size)
+            {
+                break;
+            }
+            if (child + 1 < size && heap[child + 1].key < heap[child].key)
+            {
+                child++;
+            }
+            if (heap[child].key >= last.key)
+            {
+                break;
+            }
+            heap[i] = heap[child];
+            i = child;
+        }
+        heap[i] = last;
+    }
+}
+
+/**
+ * @brief calculates the squared L2 distance between two arrays of doubles. uses four independent
+ * accumulators so the compiler can vectorize the loop.
+ * @param a: first array.
+ * @param b: second array.
+ * @param len: length of both arrays.
+ * @return the squared distance.
+ */
+double squaredDistance(const double *a, const double *b, int len)
+{
+    double acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+    int i = 0;
+    for (; i + 4 <= len; i += 4)
+    {
+        double d0 = a[i] - b[i];
+        double d1 = a[i + 1] - b[i + 1];
+        double d2 = a[i + 2] - b[i + 2];
+        double d3 = a[i + 3] - b[i + 3];
+        acc0 += d0 * d0;
+        acc1 += d1 * d1;
+        acc2 += d2 * d2;
+        acc3 += d3 * d3;
+    }
+    for (; i < len; i++)
+    {
+        double d = a[i] - b[i];
+        acc0 += d * d;
+    }
+    return (acc0 + acc1) + (acc2 + acc3);
+}
+
+/**
+ * ForEach function that appends the given vector to the index array.
+ * @param pVector pointer to Vector
+ * @param pIndex pointer to VectorIndex, its array is already allocated with enough space.
+ * @return 1 on success, 0 on failure (if the vector's length is different from the index's).
+ */
+int addVectorToIndex(const void *pVector, void *pIndex)
+{
+    const Vector *vector = (const Vector *) pVector;
+    VectorIndex *index = (VectorIndex *) pIndex;
+    if (index->size == 0)
+    {
+        index->dim = vector->len;
+    }
+    if (vector->len != index->dim || (vector->len > 0 && vector->vector == NULL))
+    {
+        return false;
+    }
+    index->vectors[index->size++] = vector;
+    return true;
+}
+
+/**
+ * @brief rearranges vectors[lo, hi) so the vector at nth has its axis coordinate in its sorted
+ * place - smaller or equal coordinates before it, greater or equal after it (quickselect).
+ * @param vectors: array of vectors.
+ * @param lo, hi: range to rearrange.
+ * @param nth: index to place.
+ * @param axis: coordinate to order by.
+ */
+void selectByAxis(const Vector **vectors, int lo, int hi, int nth, int axis)
+{
+    while (hi - lo > 1)
+    {
+        double pivot = vectors[lo + (hi - lo) / 2]->vector[axis];
+        int i = lo, j = hi - 1;
+        while (i <= j)
+        {
+            while (vectors[i]->vector[axis] < pivot)
+            {
+                i++;
+            }
+            while (vectors[j]->vector[axis] > pivot)
+            {
+                j--;
+            }
+            if (i <= j)
+            {
+                const Vector *temp = vectors[i];
+                vectors[i++] = vectors[j];
+                vectors[j--] = temp;
+            }
+        }
+        if (nth <= j)
+        {
+            hi = j + 1;
+        }
+        else if (nth >= i)
+        {
+            lo = i;
+        }
+        else
+        {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief builds the KD-tree in place: the root of vectors[lo, hi) is at the middle, split by
+ * the axis (depth % dim).
+ * @param index: the index.
+ * @param lo, hi: range of the sub-tree.
+ * @param depth: depth of the sub-tree's root.
+ */
+void buildVectorIndex(VectorIndex *index, int lo, int hi, int depth)
+{
+    if (hi - lo <= 1)
+    {
+        return;
+    }
+    int mid = lo + (hi - lo) / 2;
+    selectByAxis(index->vectors, lo, hi, mid, depth % index->dim);
+    buildVectorIndex(index, lo, mid, depth + 1);
+    buildVectorIndex(index, mid + 1, hi, depth + 1);
+}
+
+/**
+ * @brief builds a KD-tree index over all the Vectors of the given tree.
+ * @param tree a pointer to a tree of Vectors. all the vectors must have the same length.
+ * @return pointer to the new index, NULL on failure (allocation failure or vectors of different
+ * lengths).
+ */
+VectorIndex *newVectorIndex(const RBTree *tree)
+{
+    if (tree == NULL)
+    {
+        return NULL;
+    }
+    VectorIndex *index = (VectorIndex *) calloc(1, sizeof(VectorIndex));
+    if (index == NULL)
+    {
+        return NULL;
+    }
+    index->vectors = (const Vector **) malloc(sizeof(Vector *) * (tree->size + 1));
+    if (index->vectors == NULL || !forEachRBTree(tree, addVectorToIndex, index))
+    {
+        freeVectorIndex(&index);
+        return NULL;
+    }
+    if (index->dim > 0)
+    {
+        buildVectorIndex(index, 0, index->size, 0);
+    }
+    return index;
+}
+
+/**
+ * the state of a nearest-neighbor search.
+ */
+typedef struct NearestSearch
+{
+    const VectorIndex *index;
+    const double *query;
+    VectorHeapItem *heap;
+    int heapSize;
+    int k;
+} NearestSearch;
+
+/**
+ * @brief helper to findKNearestVectors - searches the sub-tree of vectors[lo, hi).
+ * @param search: the search state. its heap keeps the negated squared distances, so the root is
+ * the farthest neighbor found so far.
+ * @param lo, hi: range of the sub-tree.
+ * @param depth: depth of the sub-tree's root.
+ */
+void searchNearest(NearestSearch *search, int lo, int hi, int depth)
+{
+    if (lo >= hi)
+    {
+        return;
+    }
+    int mid = lo + (hi - lo) / 2;
+    const Vector *node = search->index->vectors[mid];
+    int dim = search->index->dim;
+    pushToBoundedHeap(search->heap, &search->heapSize, search->k,
+                      -squaredDistance(search->query, node->vector, dim), node);
+    if (hi - lo == 1 || dim == 0)
+    {
+        return;
+    }
+    int axis = depth % dim;
+    double diff = search->query[axis] - node->vector[axis];
+    if (diff < 0)
+    {
+        searchNearest(search, lo, mid, depth + 1);
+    }
+    else
+    {
+        searchNearest(search, mid + 1, hi, depth + 1);
+    }
+    // the other side may only hold closer vectors if the splitting plane is closer than the
+    // farthest neighbor found.
+    if (search->heapSize < search->k || diff * diff <= -search->heap[0].key)
+    {
+        if (diff < 0)
+        {
+            searchNearest(search, mid + 1, hi, depth + 1);
+        }
+        else
+        {
+            searchNearest(search, lo, mid, depth + 1);
+        }
+    }
+}
+
+/**
+ * @brief finds the k vectors closest (L2 distance) to the query.
+ * @param index the index to search in.
+ * @param query vector of the same length as the indexed vectors.
+ * @param k number of neighbors to find.
+ * @param out array of at least k pointers, filled with the neighbors sorted by distance (closest
+ * first). the pointers are borrowed from the indexed tree.
+ * @return number of neighbors found (min(k, number of indexed vectors)), 0 on failure.
+ */
+int findKNearestVectors(const VectorIndex *index, const Vector *query, int k, const Vector **out)
+{
+    if (index == NULL || query == NULL || out == NULL || k <= 0 || index->size == 0 ||
+        query->len != index->dim || (query->len > 0 && query->vector == NULL))
+    {
+        return 0;
+    }
+    if (k > index->size)
+    {
+        k = index->size;
+    }
+    NearestSearch search = {index, query->vector, NULL, 0, k};
+    search.heap = (VectorHeapItem *) malloc(sizeof(VectorHeapItem) * k);
+    if (search.heap == NULL)
+    {
+        return 0;
+    }
+    searchNearest(&search, 0, index->size, 0);
+    // the heap keeps negated distances - descending keys are ascending distances.
+    popBoundedHeapSorted(search.heap, search.heapSize, out);
+    free(search.heap);
+    return k;
+}
+
+/**
+ * the state of a radius search.
+ */
+typedef struct RadiusSearch
+{
+    const VectorIndex *index;
+    const double *query;
+    double squaredRadius;
+    const Vector **out;
+    int maxOut;
+    int found;
+} RadiusSearch;
+
+/**
+ * @brief helper to findVectorsInRadius - searches the sub-tree of vectors[lo, hi).
+ * @param search: the search state.
+ * @param lo, hi: range of the sub-tree.
+ * @param depth: depth of the sub-tree's root.
+ */
+void searchRadius(RadiusSearch *search, int lo, int hi, int depth)
+{
+    if (lo >= hi)
+    {
+        return;
+    }
+    int mid = lo + (hi - lo) / 2;
+    const Vector *node = search->index->vectors[mid];
+    int dim = search->index->dim;
+    if (squaredDistance(search->query, node->vector, dim) <= search->squaredRadius)
+    {
+        if (search->found < search->maxOut)
+        {
+            search->out[search->found] = node;
+        }
+        search->found++;
+    }
+    if (hi - lo == 1 || dim == 0)
+    {
+        return;
+    }
+    int axis = depth % dim;
+    double diff = search->query[axis] - node->vector[axis];
+    if (diff <= 0 || diff * diff <= search->squaredRadius)
+    {
+        searchRadius(search, lo, mid, depth + 1);
+    }
+    if (diff >= 0 || diff * diff <= search->squaredRadius)
+    {
+        searchRadius(search, mid + 1, hi, depth + 1);
+    }
+}
+
+/**
+ * @brief finds all the vectors within the given L2 distance from the query.
+ * @param index the index to search in.
+ * @param query vector of the same length as the indexed vectors.
+ * @param radius maximal distance (inclusive).
+ * @param out array of at least maxOut pointers, filled with the first maxOut matches found (in no
+ * particular order). may be NULL if maxOut is 0.
+ * @param maxOut capacity of out.
+ * @return total number of matches (may be larger than maxOut), 0 on failure.
+ */
+int findVectorsInRadius(const VectorIndex *index, const Vector *query, double radius,
+                        const Vector **out, int maxOut)
+{
+    if (index == NULL || query == NULL || radius < 0 || (out == NULL && maxOut > 0) ||
+        query->len != index->dim || (query->len > 0 && query->vector == NULL))
+    {
+        return 0;
+    }
+    RadiusSearch search = {index, query->vector, radius * radius, out, maxOut, 0};
+    searchRadius(&search, 0, index->size, 0);
+    return search.found;
+}
+
+/**
+ * @brief free the index (the indexed vectors are not freed).
+ * @param index pointer to the index to free.
+ */
+void freeVectorIndex(VectorIndex **index)
+{
+    if (index == NULL || *index == NULL)
+    {
+        return;
+    }
+    free((*index)->vectors);
+    free(*index);
+    *index = NULL;
+}
+
+
+//-------------- top-k vectors by norm. ----------------
+
+/**
+ * the state of a top-k search - a bounded heap keyed by the norms.
+ */
+typedef struct TopKSearch
+{
+    VectorHeapItem *heap;
+    int heapSize;
+    int k;
+} TopKSearch;
+
+/**
+ * ForEach function that offers the given vector to a top-k search.
+ * @param pVector pointer to Vector
+ * @param pSearch pointer to TopKSearch
+ * @return 1 on success, 0 on failure (if pVector == NULL: failure).
+ */
+int offerToTopK(const void *pVector, void *pSearch)
+{
+    const Vector *vector = (const Vector *) pVector;
+    TopKSearch *search = (TopKSearch *) pSearch;
+    if (vector == NULL || search == NULL)
+    {
+        return false;
+    }
+    if (vector->vector != NULL && vector->len > 0)
+    {
+        pushToBoundedHeap(search->heap, &search->heapSize, search->k, getNorm(vector), vector);
+    }
+    return true;
+}
+
+/**
+ * @brief copies a vector.
+ * @param vector: vector to copy.
+ * @return a new copy of the vector, NULL on failure.
+ */
+Vector *copyVector(const Vector *vector)
+{
+    Vector *copy = (Vector *) malloc(sizeof(Vector));
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+    copy->len = vector->len;
+    copy->vector = (double *) malloc(sizeof(double) * vector->len);
+    if (copy->vector == NULL)
+    {
+        free(copy);
+        return NULL;
+    }
+    memcpy(copy->vector, vector->vector, sizeof(double) * vector->len);
+    return copy;
+}
+
+/**
+ * @brief empties the heap of a top-k search into copies of its vectors.
+ * @param search: the search.
+ * @param out: array of at least search->heapSize pointers.
+ * @return number of vectors copied, 0 on failure (on failure no copies are left in out).
+ */
+int copyTopK(TopKSearch *search, Vector **out)
+{
+    int found = search->heapSize;
+    const Vector **sorted = (const Vector **) malloc(sizeof(Vector *) * (found + 1));
+    if (sorted == NULL)
+    {
+        return 0;
+    }
+    popBoundedHeapSorted(search->heap, found, sorted);
+    for (int i = 0; i < found; i++)
+    {
+        out[i] = copyVector(sorted[i]);
+        if (out[i] == NULL)
+        {
+            while (i-- > 0)
+            {
+                freeVector(out[i]);
+                out[i] = NULL;
+            }
+            free(sorted);
+            return 0;
+        }
+    }
+    free(sorted);
+    return found;
+}
+
+/**
+ * @brief finds the k vectors with the largest norms in one traversal of the tree. each norm is
+ * computed once, and only the final k vectors are copied.
+ * @param tree a pointer to a tree of Vectors
+ * @param k number of vectors to find.
+ * @param out array of at least k pointers, filled with *copies* of the vectors sorted by norm
+ * (largest first). the copies should be freed with freeVector.
+ * @return number of vectors found (min(k, tree size)), 0 on failure.
+ */
+int findTopKNormVectorsInTree(RBTree *tree, int k, Vector **out)
+{
+    if (tree == NULL || out == NULL || k <= 0)
+    {
+        return 0;
+    }
+    TopKSearch search = {NULL, 0, k};
+    search.heap = (VectorHeapItem *) malloc(sizeof(VectorHeapItem) * k);
+    if (search.heap == NULL)
+    {
+        return 0;
+    }
+    int found = 0;
+    if (forEachRBTree(tree, offerToTopK, &search))
+    {
+        found = copyTopK(&search, out);
+    }
+    free(search.heap);
+    return found;
+}
+
+/**
+ * the work of one thread of findTopKNormVectorsInTreeParallel - the roots of the sub-trees it
+ * scans, and its own top-k search.
+ */
+typedef struct TopKWorker
+{
+    Node **roots;
+    int numRoots;
+    TopKSearch search;
+    int status;
+} TopKWorker;
+
+/**
+ * @brief thread function of findTopKNormVectorsInTreeParallel - offers all the vectors of the
+ * worker's sub-trees to its search (pre-order traversal with an explicit stack).
+ * @param pWorker: pointer to TopKWorker.
+ * @return NULL.
+ */
+void *scanTopKSubTrees(void *pWorker)
+{
+    TopKWorker *worker = (TopKWorker *) pWorker;
+    int capacity = 64, top = 0;
+    Node **stack = (Node **) malloc(sizeof(Node *) * capacity);
+    worker->status = stack != NULL;
+    for (int r = 0; r < worker->numRoots && worker->status; r++)
+    {
+        stack[top++] = worker->roots[r];
+        while (top > 0 && worker->status)
+        {
+            Node *node = stack[--top];
+            offerToTopK(node->data, &worker->search);
+            if (top + 2 > capacity)
+            {
+                Node **bigger = (Node **) realloc(stack, sizeof(Node *) * capacity * 2);
+                if (bigger == NULL)
+                {
+                    worker->status = false;
+                    break;
+                }
+                stack = bigger;
+                capacity *= 2;
+            }
+            if (node->left != NULL)
+            {
+                stack[top++] = node->left;
+            }
+            if (node->right != NULL)
+            {
+                stack[top++] = node->right;
+            }
+        }
+    }
+    free(stack);
+    return NULL;
+}
+
+/**
+ * @brief same as findTopKNormVectorsInTree, but splits the tree into sub-trees that are scanned by
+ * numThreads threads, each keeping its own top k, and merges the results.
+ * @param tree a pointer to a tree of Vectors
+ * @param k number of vectors to find.
+ * @param out array of at least k pointers, filled with *copies* of the vectors sorted by norm
+ * (largest first). the copies should be freed with freeVector.
+ * @param numThreads number of threads to use.
+ * @return number of vectors found (min(k, tree size)), 0 on failure.
+ */
+int findTopKNormVectorsInTreeParallel(RBTree *tree, int k, Vector **out, int numThreads)
+{
+    if (numThreads <= 1 || tree == NULL || tree->size < (long unsigned) numThreads * 4)
+    {
+        return findTopKNormVectorsInTree(tree, k, out);
+    }
+    if (out == NULL || k <= 0)
+    {
+        return 0;
+    }
+    // the merged search gets the nodes above the split level, the workers the sub-trees below.
+    int numRoots = 0, maxRoots = numThreads * 4;
+    Node **roots = (Node **) malloc(sizeof(Node *) * maxRoots * 4);
+    TopKWorker *workers = (TopKWorker *) calloc(numThreads, sizeof(TopKWorker));
+    pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * numThreads);
+    TopKSearch merged = {(VectorHeapItem *) malloc(sizeof(VectorHeapItem) * k), 0, k};
+    int found = 0, started = 0, status = roots != NULL && workers != NULL && threads != NULL &&
+                                         merged.heap != NULL;
+    for (int i = 0; i < numThreads && status; i++)
+    {
+        workers[i].search.heap = (VectorHeapItem *) malloc(sizeof(VectorHeapItem) * k);
+        workers[i].search.k = k;
+        status = workers[i].search.heap != NULL;
+    }
+    if (status)
+    {
+        // split level by level until there are enough sub-trees to balance the threads.
+        roots[numRoots++] = tree->root;
+        while (numRoots > 0 && numRoots < maxRoots)
+        {
+            int next = 0;
+            Node **level = roots + maxRoots * 2;
+            for (int i = 0; i < numRoots; i++)
+            {
+                offerToTopK(roots[i]->data, &merged);
+                if (roots[i]->left != NULL)
+                {
+                    level[next++] = roots[i]->left;
+                }
+                if (roots[i]->right != NULL)
+                {
+                    level[next++] = roots[i]->right;
+                }
+            }
+            memcpy(roots, level, sizeof(Node *) * next);
+            numRoots = next;
+        }
+        for (int i = 0; i < numThreads; i++)
+        {
+            // sub-trees are dealt as contiguous runs, so each thread gets numRoots / numThreads.
+            workers[i].roots = roots + (numRoots * i) / numThreads;
+            workers[i].numRoots = (numRoots * (i + 1)) / numThreads - (numRoots * i) / numThreads;
+        }
+        for (; started < numThreads; started++)
+        {
+            if (pthread_create(&threads[started], NULL, scanTopKSubTrees, &workers[started]) != 0)
+            {
+                break;
+            }
+        }
+        // scan the work of the threads that failed to start here.
+        for (int i = started; i < numThreads; i++)
+        {
+            scanTopKSubTrees(&workers[i]);
+        }
+        for (int i = 0; i < started; i++)
+        {
+            pthread_join(threads[i], NULL);
+        }
+        for (int i = 0; i < numThreads; i++)
+        {
+            status = status && workers[i].status;
+            for (int j = 0; j < workers[i].search.heapSize; j++)
+            {
+                pushToBoundedHeap(merged.heap, &merged.heapSize, k, workers[i].search.heap[j].key,
+                                  workers[i].search.heap[j].vector);
+            }
+        }
+        if (status)
+        {
+            found = copyTopK(&merged, out);
+        }
+    }
+    for (int i = 0; workers != NULL && i < numThreads; i++)
+    {
+        free(workers[i].search.heap);
+    }
+    free(merged.heap);
+    free(threads);
+    free(workers);
+    free(roots);
+    return found;
+}
+
+//-------------- aggregate statistics. ----------------
+
+typedef struct StatsPass StatsPass;
+
+/**
+ * a loop over the elements of a vector that adds them to some of the statistics of a pass.
+ * @return the squared norm of the elements if the kernel computes it, 0 otherwise.
+ */
+typedef double (*StatsKernel)(StatsPass *pass, const double *elements, int len, double weight);
+
+/**
+ * the state of one pass of computeVectorStats - a run of count nodes from first. lengths[l] counts
+ * the vectors of length l, so the per-dimension counts are found at the end instead of counted
+ * for every element. kernels are the loops of the requested statistics.
+ */
+struct StatsPass
+{
+    const VectorStatsRequest *request;
+    const Node *first;
+    long unsigned count;
+    int dim;
+    double *sum, *min, *max;
+    long unsigned *lengths;
+    long unsigned *histogram;
+    const Vector *maxNorm;
+    double maxNormSquared;
+    StatsKernel kernels[3];
+    int numKernels;
+    int status;
+};
+
+/**
+ * @brief grows the per-dimension statistics of a pass to a new dimension.
+ * @param pass the pass.
+ * @param dim the new dimension (larger than the current one).
+ * @return 1 on success, 0 on failure.
+ */
+int growStatsPass(StatsPass *pass, int dim)
+{
+    long unsigned *lengths = (long unsigned *) realloc(pass->lengths,
+                                                       sizeof(long unsigned) * (dim + 1));
+    if (lengths == NULL)
+    {
+        return false;
+    }
+    pass->lengths = lengths;
+    memset(lengths + pass->dim + 1, 0, sizeof(long unsigned) * (dim - pass->dim));
+    double **arrays[] = {&pass->sum, &pass->min, &pass->max};
+    double initial[] = {0, INFINITY, -INFINITY};
+    for (int a = 0; a < 3; a++)
+    {
+        double *grown = (double *) realloc(*arrays[a], sizeof(double) * dim);
+        if (grown == NULL)
+        {
+            return false;
+        }
+        *arrays[a] = grown;
+        for (int i = pass->dim; i < dim; i++)
+        {
+            grown[i] = initial[a];
+        }
+    }
+    pass->dim = dim;
+    return true;
+}
+
+/**
+ * @brief the fused kernel of a pass that computes everything - adds elements to the sums, the
+ * minimums and the maximums, and finds their norm, in one loop. the loop keeps four independent
+ * sums of the norm, so the compiler can vectorize it.
+ * @param pass the pass.
+ * @param elements the elements of a vector.
+ * @param len the number of elements.
+ * @param weight the occurrences of the vector.
+ * @return the squared norm of the elements.
+ */
+double addToAllStats(StatsPass *pass, const double *elements, int len, double weight)
+{
+    double *sum = pass->sum, *min = pass->min, *max = pass->max;
+    double norms[4] = {0, 0, 0, 0};
+    int i = 0;
+    for (; i + 4 <= len; i += 4)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            double element = elements[i + j];
+            norms[j] += element * element;
+            sum[i + j] += weight * element;
+            min[i + j] = element < min[i + j] ? element : min[i + j];
+            max[i + j] = element > max[i + j] ? element : max[i + j];
+        }
+    }
+    for (; i < len; i++)
+    {
+        double element = elements[i];
+        norms[0] += element * element;
+        sum[i] += weight * element;
+        min[i] = element < min[i] ? element : min[i];
+        max[i] = element > max[i] ? element : max[i];
+    }
+    return (norms[0] + norms[1]) + (norms[2] + norms[3]);
+}
+
+/**
+ * @brief the kernel of the sums - adds weighted elements to the sums of a pass.
+ * @param pass the pass.
+ * @param elements the elements of a vector.
+ * @param len the number of elements.
+ * @param weight the occurrences of the vector.
+ * @return 0 (the norm is not computed).
+ */
+double addToSums(StatsPass *pass, const double *elements, int len, double weight)
+{
+    double *sum = pass->sum;
+    for (int i = 0; i < len; i++)
+    {
+        sum[i] += weight * elements[i];
+    }
+    return 0;
+}
+
+/**
+ * @brief the kernel of the minimums and the maximums of a pass.
+ * @param pass the pass.
+ * @param elements the elements of a vector.
+ * @param len the number of elements.
+ * @param weight unused - the extremes do not depend on the occurrences.
+ * @return 0 (the norm is not computed).
+ */
+double addToMinMax(StatsPass *pass, const double *elements, int len, double weight)
+{
+    (void) weight;
+    double *min = pass->min, *max = pass->max;
+    for (int i = 0; i < len; i++)
+    {
+        min[i] = elements[i] < min[i] ? elements[i] : min[i];
+        max[i] = elements[i] > max[i] ? elements[i] : max[i];
+    }
+    return 0;
+}
+
+/**
+ * @brief the kernel of the norm - for the histogram and the largest norm. keeps four independent
+ * sums, as addToAllStats.
+ * @param pass unused.
+ * @param elements the elements of a vector.
+ * @param len the number of elements.
+ * @param weight unused - the norm does not depend on the occurrences.
+ * @return the squared norm of the elements.
+ */
+double squaredNormKernel(StatsPass *pass, const double *elements, int len, double weight)
+{
+    (void) pass;
+    (void) weight;
+    double norms[4] = {0, 0, 0, 0};
+    int i = 0;
+    for (; i + 4 <= len; i += 4)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            norms[j] += elements[i + j] * elements[i + j];
+        }
+    }
+    for (; i < len; i++)
+    {
+        norms[0] += elements[i] * elements[i];
+    }
+    return (norms[0] + norms[1]) + (norms[2] + norms[3]);
+}
+
+/**
+ * @brief chooses the kernels of a pass from the requested statistics, once for the whole pass, so
+ * statistics that were not requested cost nothing per vector. a request of everything gets the
+ * fused kernel, any other one a kernel for every statistic it asks for.
+ * @param pass the pass.
+ */
+void chooseStatsKernels(StatsPass *pass)
+{
+    int flags = pass->request->flags;
+    int norm = (flags & (VECTOR_STATS_NORM_HISTOGRAM | VECTOR_STATS_MAX_NORM)) != 0;
+    pass->numKernels = 0;
+    if ((flags & VECTOR_STATS_SUM) && (flags & VECTOR_STATS_MIN_MAX) && norm)
+    {
+        pass->kernels[pass->numKernels++] = addToAllStats;
+        return;
+    }
+    if (flags & VECTOR_STATS_SUM)
+    {
+        pass->kernels[pass->numKernels++] = addToSums;
+    }
+    if (flags & VECTOR_STATS_MIN_MAX)
+    {
+        pass->kernels[pass->numKernels++] = addToMinMax;
+    }
+    if (norm)
+    {
+        pass->kernels[pass->numKernels++] = squaredNormKernel;
+    }
+}
+
+/**
+ * @brief adds the vector of a node to the statistics of a pass with the pass's kernels, weighted
+ * by the node's count (the occurrences of the vector in a multiset). a vector with no elements (or
+ * a negative length) counts as an empty vector.
+ * @param pass the pass.
+ * @param node the node of the vector.
+ * @return 1 on success, 0 on failure.
+ */
+int addToStatsPass(StatsPass *pass, const Node *node)
+{
+    const Vector *vector = (const Vector *) node->data;
+    if (vector == NULL)
+    {
+        return false;
+    }
+    int len = vector->vector != NULL && vector->len > 0 ? vector->len : 0;
+    if (len > pass->dim && !growStatsPass(pass, len))
+    {
+        return false;
+    }
+    double normSquared = 0;
+    for (int k = 0; k < pass->numKernels; k++)
+    {
+        normSquared += pass->kernels[k](pass, vector->vector, len, (double) node->count);
+    }
+    pass->lengths[len] += node->count;
+    if (pass->histogram != NULL)
+    {
+        const VectorStatsRequest *request = pass->request;
+        double bin = sqrt(normSquared) / request->histogramMax * request->numBins;
+        pass->histogram[bin < request->numBins ? (int) bin : request->numBins - 1] += node->count;
+    }
+    if ((pass->request->flags & VECTOR_STATS_MAX_NORM) &&
+        (pass->maxNorm == NULL || normSquared > pass->maxNormSquared))
+    {
+        pass->maxNorm = vector;
+        pass->maxNormSquared = normSquared;
+    }
+    return true;
+}
+
+/**
+ * @brief thread function of computeVectorStats - adds the vectors of the pass's run of nodes.
+ * @param pPass pointer to StatsPass.
+ * @return NULL.
+ */
+void *runStatsPass(void *pPass)
+{
+    StatsPass *pass = (StatsPass *) pPass;
+    const Node *node = pass->first;
+    chooseStatsKernels(pass);
+    for (long unsigned i = 0; i < pass->count && pass->status; i++, node = RBTreeNext(node))
+    {
+        pass->status = addToStatsPass(pass, node);
+    }
+    return NULL;
+}
+
+/**
+ * @brief merges a pass into another - of an earlier run, so ties of the largest norm keep the
+ * first vector, as in a single pass.
+ * @param into the pass of the earlier run.
+ * @param from the pass of the later run.
+ * @return 1 on success, 0 on failure.
+ */
+int mergeStatsPasses(StatsPass *into, const StatsPass *from)
+{
+    if (from->dim > into->dim && !growStatsPass(into, from->dim))
+    {
+        return false;
+    }
+    for (int i = 0; i < from->dim; i++)
+    {
+        into->sum[i] += from->sum[i];
+        into->min[i] = from->min[i] < into->min[i] ? from->min[i] : into->min[i];
+        into->max[i] = from->max[i] > into->max[i] ? from->max[i] : into->max[i];
+    }
+    for (int l = 0; l <= from->dim; l++)
+    {
+        into->lengths[l] += from->lengths[l];
+    }
+    for (int b = 0; into->histogram != NULL && b < into->request->numBins; b++)
+    {
+        into->histogram[b] += from->histogram[b];
+    }
+    if (from->maxNorm != NULL &&
+        (into->maxNorm == NULL || from->maxNormSquared > into->maxNormSquared))
+    {
+        into->maxNorm = from->maxNorm;
+        into->maxNormSquared = from->maxNormSquared;
+    }
+    return true;
+}
+
+/**
+ * @brief frees the memory of a pass.
+ * @param pass the pass.
+ */
+void freeStatsPass(StatsPass *pass)
+{
+    free(pass->sum);
+    free(pass->min);
+    free(pass->max);
+    free(pass->lengths);
+    free(pass->histogram);
+}
+
+/**
+ * @brief runs the passes of computeVectorStats - each on its own thread, except the first one,
+ * which runs on the calling thread - and merges them into the first.
+ * @param passes the passes.
+ * @param numPasses number of passes.
+ * @return 1 on success, 0 on failure.
+ */
+int runStatsPasses(StatsPass *passes, int numPasses)
+{
+    pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * numPasses);
+    int started = 1;
+    for (; threads != NULL && started < numPasses; started++)
+    {
+        if (pthread_create(&threads[started], NULL, runStatsPass, &passes[started]) != 0)
+        {
+            break;
+        }
+    }
+    // run the passes that failed to start here.
+    runStatsPass(&passes[0]);
+    for (int i = started; i < numPasses; i++)
+    {
+        runStatsPass(&passes[i]);
+    }
+    for (int i = 1; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    int status = true;
+    for (int i = 0; i < numPasses; i++)
+    {
+        status = status && passes[i].status && (i == 0 || mergeStatsPasses(&passes[0], &passes[i]));
+    }
+    return status;
+}
+
+/**
+ * @brief builds the statistics from a finished pass.
+ * @param pass the pass, with the statistics of all the vectors.
+ * @return the statistics, NULL on failure.
+ */
+VectorStats *buildVectorStats(StatsPass *pass)
+{
+    int flags = pass->request->flags, dim = pass->dim;
+    VectorStats *stats = (VectorStats *) calloc(1, sizeof(VectorStats));
+    if (stats == NULL)
+    {
+        return NULL;
+    }
+    stats->dim = dim;
+    stats->dimCount = (long unsigned *) malloc(sizeof(long unsigned) * (dim + 1));
+    if (stats->dimCount == NULL)
+    {
+        freeVectorStats(&stats);
+        return NULL;
+    }
+    // vectors longer than i: the lengths above i, summed from the longest down.
+    long unsigned longer = 0;
+    for (int i = dim; i >= 0; i--)
+    {
+        stats->count += pass->lengths[i];
+        stats->dimCount[i] = longer;
+        longer += pass->lengths[i];
+    }
+    if (flags & VECTOR_STATS_SUM)
+    {
+        stats->mean = (double *) malloc(sizeof(double) * (dim + 1));
+        if (stats->mean == NULL)
+        {
+            freeVectorStats(&stats);
+            return NULL;
+        }
+        for (int i = 0; i < dim; i++)
+        {
+            stats->mean[i] = pass->sum[i] / (double) stats->dimCount[i];
+        }
+        stats->sum = pass->sum;
+        pass->sum = NULL;
+    }
+    if (flags & VECTOR_STATS_MIN_MAX)
+    {
+        stats->min = pass->min;
+        stats->max = pass->max;
+        pass->min = pass->max = NULL;
+    }
+    if (flags & VECTOR_STATS_NORM_HISTOGRAM)
+    {
+        stats->histogram = pass->histogram;
+        stats->numBins = pass->request->numBins;
+        pass->histogram = NULL;
+    }
+    if (flags & VECTOR_STATS_MAX_NORM)
+    {
+        stats->maxNorm = pass->maxNorm;
+        stats->maxNormValue = sqrt(pass->maxNormSquared);
+    }
+    return stats;
+}
+
+/**
+ * @brief computes all the requested statistics of a range of the vectors of a tree in a single
+ * pass. the range is split by rank between the threads, so each gets a contiguous run of nodes.
+ * @param tree a pointer to a tree of Vectors
+ * @param request the statistics to compute, and the range.
+ * @return the statistics, NULL on failure.
+ */
+VectorStats *computeVectorStats(const RBTree *tree, const VectorStatsRequest *request)
+{
+    if (tree == NULL || request == NULL)
+    {
+        return NULL;
+    }
+    if ((request->flags & VECTOR_STATS_NORM_HISTOGRAM) &&
+        (request->numBins <= 0 || !(request->histogramMax > 0)))
+    {
+        return NULL;
+    }
+    long unsigned first = request->low == NULL ? 0 : RBTreeRank(tree, request->low);
+    long unsigned count = RBTreeCountRange(tree, request->low, request->high);
+    int numPasses = request->numThreads;
+    // the walks of a tree with clones set the parents of the nodes they pass (RBTreeNext), so
+    // they cannot run in parallel.
+    if (numPasses < 1 || count < (long unsigned) numPasses * 4 || tree->family != NULL)
+    {
+        numPasses = 1;
+    }
+    StatsPass *passes = (StatsPass *) calloc(numPasses, sizeof(StatsPass));
+    int status = passes != NULL;
+    for (int i = 0; status && i < numPasses; i++)
+    {
+        long unsigned start = first + (count * i) / numPasses;
+        passes[i].request = request;
+        passes[i].first = RBTreeSelect(tree, start);
+        passes[i].count = first + (count * (i + 1)) / numPasses - start;
+        passes[i].lengths = (long unsigned *) calloc(1, sizeof(long unsigned));
+        passes[i].status = passes[i].lengths != NULL;
+        if (request->flags & VECTOR_STATS_NORM_HISTOGRAM)
+        {
+            passes[i].histogram = (long unsigned *) calloc(request->numBins,
+                                                           sizeof(long unsigned));
+            passes[i].status = passes[i].status && passes[i].histogram != NULL;
+        }
+        status = passes[i].status;
+    }
+    VectorStats *stats = NULL;
+    if (status && runStatsPasses(passes, numPasses))
+    {
+        stats = buildVectorStats(&passes[0]);
+    }
+    for (int i = 0; passes != NULL && i < numPasses; i++)
+    {
+        freeStatsPass(&passes[i]);
+    }
+    free(passes);
+    return stats;
+}
+
+/**
+ * @brief free the statistics.
+ * @param stats pointer to the statistics to free.
+ */
+void freeVectorStats(VectorStats **stats)
+{
+    if (stats == NULL || *stats == NULL)
+    {
+        return;
+    }
+    free((*stats)->dimCount);
+    free((*stats)->sum);
+    free((*stats)->mean);
+    free((*stats)->min);
+    free((*stats)->max);
+    free((*stats)->histogram);
+    free(*stats);
+    *stats = NULL;
+}
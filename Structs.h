@@ -16,6 +16,16 @@ typedef struct Vector
 	double *vector;
 } Vector;
 
+/**
+ * Represents a string that knows its length, so it may hold "\0" and is compared without
+ * scanning for its end. chars is allocated with the struct (newLenString), and ends with "\0".
+ */
+typedef struct LenString
+{
+	size_t len;
+	char *chars;
+} LenString;
+
 
 /**
  * CompFunc for strings (assumes strings end with "\0")
@@ -40,6 +50,76 @@ int concatenate(const void *word, void *pConcatenated); // implement it in Struc
  */
 void freeString(void *s); // implement it in Structs.c
 
+/**
+ * SizeFunc for strings
+ * @param s - char* pointer
+ * @return number of bytes of the string, with its "\0".
+ */
+size_t stringSize(const void *s);
+
+/**
+ * RelocateFunc for strings - copies the string into the arena.
+ * @param s - char* pointer
+ * @param arena - the arena to allocate the copy from.
+ * @return pointer to the copy, NULL on failure.
+ */
+void *relocateString(const void *s, Arena *arena);
+
+/**
+ * creates a LenString, as a single allocation.
+ * @param chars - the bytes of the string (copied).
+ * @param len - number of bytes.
+ * @return the new string (free it with freeLenString), NULL on failure.
+ */
+LenString *newLenString(const char *chars, size_t len);
+
+/**
+ * CompFunc for LenStrings - compares the bytes as unsigned, a string is smaller than its
+ * extensions (the order of memcmp).
+ * @param a - LenString* pointer
+ * @param b - LenString* pointer
+ * @return equal to 0 iff a == b. lower than 0 if a < b. Greater than 0 iff b < a.
+ */
+int lenStringCompare(const void *a, const void *b);
+
+/**
+ * LcpCompareFunc for LenStrings - the order of lenStringCompare, comparing 16 bytes at a time
+ * where SSE2 is available.
+ * @param a - LenString* pointer
+ * @param b - LenString* pointer
+ * @param skip - number of leading bytes known to be equal.
+ * @param lcp - set to the length of the common prefix of a and b.
+ * @return equal to 0 iff a == b. lower than 0 if a < b. Greater than 0 iff b < a.
+ */
+int lenStringLcpCompare(const void *a, const void *b, size_t skip, size_t *lcp);
+
+/**
+ * KeyPrefixFunc for LenStrings - the first 8 bytes, packed big-endian.
+ * @param s - LenString* pointer
+ * @return the prefix of the string.
+ */
+unsigned long long lenStringKeyPrefix(const void *s);
+
+/**
+ * FreeFunc for LenStrings
+ */
+void freeLenString(void *s);
+
+/**
+ * SizeFunc for LenStrings
+ * @param s - LenString* pointer
+ * @return number of bytes of the string, with its struct and its "\0".
+ */
+size_t lenStringSize(const void *s);
+
+/**
+ * RelocateFunc for LenStrings - copies the string into the arena.
+ * @param s - LenString* pointer
+ * @param arena - the arena to allocate the copy from.
+ * @return pointer to the copy, NULL on failure.
+ */
+void *relocateLenString(const void *s, Arena *arena);
+
 /**
  * CompFunc for Vectors, compares element by element, the vector that has the first larger
  * element is considered larger. If vectors are of different lengths and identify for the length
@@ -50,11 +130,40 @@ void freeString(void *s); // implement it in Structs.c
  */
 int vectorCompare1By1(const void *a, const void *b); // implement it in Structs.c
 
+/**
+ * KeyPrefixFunc for strings - the first 8 bytes, packed big-endian.
+ * @param s - char* pointer
+ * @return the prefix of the string.
+ */
+unsigned long long stringKeyPrefix(const void *s);
+
+/**
+ * KeyPrefixFunc for vectors - an order-preserving encoding of the first element.
+ * @param pVector - pointer to Vector
+ * @return the prefix of the vector.
+ */
+unsigned long long vectorKeyPrefix(const void *pVector);
+
 /**
  * FreeFunc for vectors
  */
 void freeVector(void *pVector); // implement it in Structs.c
 
+/**
+ * SizeFunc for vectors
+ * @param pVector - pointer to Vector
+ * @return number of bytes of the vector and its elements.
+ */
+size_t vectorSize(const void *pVector);
+
+/**
+ * RelocateFunc for vectors - copies the vector and its elements into the arena.
+ * @param pVector - pointer to Vector
+ * @param arena - the arena to allocate the copy from.
+ * @return pointer to the copy, NULL on failure.
+ */
+void *relocateVector(const void *pVector, Arena *arena);
+
 /**
  * copy pVector to pMaxVector if : 1. The norm of pVector is greater then the norm of pMaxVector.
  * 								   2. pMaxVector->vector == NULL.
@@ -70,5 +179,156 @@ int copyIfNormIsLarger(const void *pVector, void *pMaxVector); // implement it i
  */
 Vector *findMaxNormVectorInTree(RBTree *tree); // implement it in Structs.c You must use copyIfNormIsLarger in the implementation!
 
+/**
+ * @param tree a pointer to a tree of Vectors
+ * @return pointer to the vector that has the largest norm (L2 Norm), borrowed from the tree (no
+ * copy is made). NULL if the tree is empty.
+ */
+const Vector *peekMaxNormVectorInTree(const RBTree *tree);
+
+/**
+ * finds the k vectors with the largest norms in one traversal of the tree. each norm is computed
+ * once, and only the final k vectors are copied.
+ * @param tree a pointer to a tree of Vectors
+ * @param k number of vectors to find.
+ * @param out array of at least k pointers, filled with *copies* of the vectors sorted by norm
+ * (largest first). the copies should be freed with freeVector.
+ * @return number of vectors found (min(k, tree size)), 0 on failure.
+ */
+int findTopKNormVectorsInTree(RBTree *tree, int k, Vector **out);
+
+/**
+ * same as findTopKNormVectorsInTree, but splits the tree into sub-trees that are scanned by
+ * numThreads threads, each keeping its own top k, and merges the results.
+ * @param tree a pointer to a tree of Vectors
+ * @param k number of vectors to find.
+ * @param out array of at least k pointers, filled with *copies* of the vectors sorted by norm
+ * (largest first). the copies should be freed with freeVector.
+ * @param numThreads number of threads to use.
+ * @return number of vectors found (min(k, tree size)), 0 on failure.
+ */
+int findTopKNormVectorsInTreeParallel(RBTree *tree, int k, Vector **out, int numThreads);
+
+/**
+ * the statistics computeVectorStats can compute, combined with |.
+ * VECTOR_STATS_SUM: the sum and the mean of every dimension.
+ * VECTOR_STATS_MIN_MAX: the minimum and the maximum of every dimension.
+ * VECTOR_STATS_NORM_HISTOGRAM: a histogram of the norms (L2 Norm).
+ * VECTOR_STATS_MAX_NORM: the vector with the largest norm.
+ */
+typedef enum VectorStatsFlags
+{
+	VECTOR_STATS_SUM = 1 << 0,
+	VECTOR_STATS_MIN_MAX = 1 << 1,
+	VECTOR_STATS_NORM_HISTOGRAM = 1 << 2,
+	VECTOR_STATS_MAX_NORM = 1 << 3
+} VectorStatsFlags;
+
+/**
+ * what computeVectorStats should compute, and over which vectors.
+ * flags: the VectorStatsFlags of the statistics.
+ * numBins, histogramMax: the histogram has numBins bins of equal width over [0, histogramMax) -
+ * larger norms are counted in the last bin.
+ * low, high: the smallest and the largest vectors of the range (inclusive). NULL for no bound.
+ * numThreads: number of threads to split the range between (1 or less - the calling thread). a
+ * tree with clones (RBTreeClone) is walked by the calling thread only.
+ */
+typedef struct VectorStatsRequest
+{
+	int flags;
+	int numBins;
+	double histogramMax;
+	const Vector *low;
+	const Vector *high;
+	int numThreads;
+} VectorStatsRequest;
+
+/**
+ * the statistics of a range of vectors. the arrays of statistics that were not requested are
+ * NULL. dimension i of the per-dimension statistics is over the dimCount[i] vectors that are
+ * longer than i. in a multiset, every vector counts as many times as it occurs (count, dimCount,
+ * sum, mean and the histogram).
+ */
+typedef struct VectorStats
+{
+	long unsigned count;
+	int dim;
+	long unsigned *dimCount;
+	double *sum;
+	double *mean;
+	double *min;
+	double *max;
+	long unsigned *histogram;
+	int numBins;
+	const Vector *maxNorm;
+	double maxNormValue;
+} VectorStats;
+
+/**
+ * computes all the requested statistics of the vectors of a tree in a single pass. every vector
+ * is read once, by one loop that updates all the statistics.
+ * @param tree a pointer to a tree of Vectors
+ * @param request the statistics to compute, and the range.
+ * @return the statistics (to be freed with freeVectorStats). maxNorm is borrowed from the tree.
+ * NULL on failure.
+ */
+VectorStats *computeVectorStats(const RBTree *tree, const VectorStatsRequest *request);
+
+/**
+ * free the statistics.
+ * @param stats pointer to the statistics to free.
+ */
+void freeVectorStats(VectorStats **stats);
+
+/**
+ * a KD-tree over the Vectors of a tree, for nearest-neighbor and radius queries.
+ * The index borrows the Vectors of the tree it was built from - it is valid only as long as that
+ * tree is not modified or freed.
+ */
+typedef struct VectorIndex
+{
+	const Vector **vectors;
+	int size;
+	int dim;
+} VectorIndex;
+
+/**
+ * builds a KD-tree index over all the Vectors of the given tree.
+ * @param tree a pointer to a tree of Vectors. all the vectors must have the same length.
+ * @return pointer to the new index, NULL on failure (allocation failure or vectors of different
+ * lengths).
+ */
+VectorIndex *newVectorIndex(const RBTree *tree);
+
+/**
+ * finds the k vectors closest (L2 distance) to the query.
+ * @param index the index to search in.
+ * @param query vector of the same length as the indexed vectors.
+ * @param k number of neighbors to find.
+ * @param out array of at least k pointers, filled with the neighbors sorted by distance (closest
+ * first). the pointers are borrowed from the indexed tree.
+ * @return number of neighbors found (min(k, number of indexed vectors)), 0 on failure.
+ */
+int findKNearestVectors(const VectorIndex *index, const Vector *query, int k, const Vector **out);
+
+/**
+ * finds all the vectors within the given L2 distance from the query.
+ * @param index the index to search in.
+ * @param query vector of the same length as the indexed vectors.
+ * @param radius maximal distance (inclusive).
+ * @param out array of at least maxOut pointers, filled with the first maxOut matches found (in no
+ * particular order). may be NULL if maxOut is 0.
+ * @param maxOut capacity of out.
+ * @return total number of matches (may be larger than maxOut), 0 on failure.
+ */
+int findVectorsInRadius(const VectorIndex *index, const Vector *query, double radius,
+						const Vector **out, int maxOut);
+
+/**
+ * free the index (the indexed vectors are not freed).
+ * @param index pointer to the index to free.
+ */
+void freeVectorIndex(VectorIndex **index);
+
 
 #endif //TA_EX3_STRUCTS_H
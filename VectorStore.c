@@ -0,0 +1,553 @@
+/**
+ * @file VectorStore.c
+ * @date 18 october 2026
+ * @brief a set of vectors kept as float32 or 8-bit quantized elements. comparisons and norm scans
+ * run on the compressed elements, and read the original doubles only when they cannot decide.
+*/
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include <float.h>
+#include "VectorStore.h"
+#define LESS (-1)
+#define EQUAL (0)
+#define GREATER (1)
+#define INT8_LEVELS 127
+#define INT8_BIAS 128
+#define INITIAL_CANDIDATES 16
+
+/**
+ * a vector in its compressed form. float32 elements are stored as floats, int8 elements as bytes
+ * biased by INT8_BIAS, so their byte order is their numeric order.
+ */
+typedef struct CompressedVector
+{
+    const Vector *original;
+    int len;
+    float elements[];
+} CompressedVector;
+
+struct VectorStore
+{
+    VectorEncoding encoding;
+    double maxAbs;
+    double scale;
+    RBTree *tree;
+};
+
+/**
+ * @brief the size of a compressed vector.
+ * @param encoding: the encoding of the elements.
+ * @param len: number of elements.
+ * @return number of bytes.
+ */
+size_t compressedVectorSize(VectorEncoding encoding, int len)
+{
+    size_t elementSize = encoding == VECTOR_ENCODING_INT8 ? sizeof(unsigned char) : sizeof(float);
+    return offsetof(CompressedVector, elements) + elementSize * (size_t) len;
+}
+
+/**
+ * @brief compresses a vector by the encoding and the scale of the store. both encodings are
+ * monotonic - a larger element never gets a smaller code - so comparing codes never contradicts
+ * comparing the elements, it may only fail to tell them apart.
+ * @param store: the store.
+ * @param vector: the vector to compress.
+ * @return the compressed vector (to be freed with free), NULL if one of the elements is larger
+ * than the store accepts or on allocation failure.
+ */
+CompressedVector *compressVector(const VectorStore *store, const Vector *vector)
+{
+    if (vector == NULL || vector->len < 0 || (vector->len > 0 && vector->vector == NULL))
+    {
+        return NULL;
+    }
+    CompressedVector *compressed = (CompressedVector *) malloc(
+            compressedVectorSize(store->encoding, vector->len));
+    if (compressed == NULL)
+    {
+        return NULL;
+    }
+    compressed->original = vector;
+    compressed->len = vector->len;
+    unsigned char *codes = (unsigned char *) compressed->elements;
+    for (int i = 0; i < vector->len; i++)
+    {
+        double element = vector->vector[i];
+        if (!(fabs(element) <= store->maxAbs))
+        {
+            free(compressed);
+            return NULL;
+        }
+        if (store->encoding == VECTOR_ENCODING_FLOAT32)
+        {
+            compressed->elements[i] = (float) element;
+        }
+        else
+        {
+            long code = lround(element / store->scale);
+            code = code > INT8_LEVELS ? INT8_LEVELS : code < -INT8_LEVELS ? -INT8_LEVELS : code;
+            codes[i] = (unsigned char) (code + INT8_BIAS);
+        }
+    }
+    return compressed;
+}
+
+/**
+ * @brief breaks a tie of the compressed forms by the lengths, then by the original elements.
+ * @param a: first compressed vector.
+ * @param b: second compressed vector.
+ * @return equal to 0 iff a == b. lower than 0 if a < b. Greater than 0 iff b < a.
+ */
+int compareCompressedTie(const CompressedVector *a, const CompressedVector *b)
+{
+    if (a->len != b->len)
+    {
+        return a->len < b->len ? LESS : GREATER;
+    }
+    return vectorCompare1By1(a->original, b->original);
+}
+
+/**
+ * @brief CompFunc for float32 compressed vectors.
+ * @param a: first compressed vector.
+ * @param b: second compressed vector.
+ * @return equal to 0 iff a == b. lower than 0 if a < b. Greater than 0 iff b < a.
+ */
+int compareFloat32Vectors(const void *a, const void *b)
+{
+    const CompressedVector *first = (const CompressedVector *) a;
+    const CompressedVector *second = (const CompressedVector *) b;
+    int len = first->len < second->len ? first->len : second->len;
+    for (int i = 0; i < len; i++)
+    {
+        if (first->elements[i] != second->elements[i])
+        {
+            return first->elements[i] < second->elements[i] ? LESS : GREATER;
+        }
+    }
+    return compareCompressedTie(first, second);
+}
+
+/**
+ * @brief CompFunc for int8 compressed vectors - the codes are biased, so memcmp orders them.
+ * @param a: first compressed vector.
+ * @param b: second compressed vector.
+ * @return equal to 0 iff a == b. lower than 0 if a < b. Greater than 0 iff b < a.
+ */
+int compareInt8Vectors(const void *a, const void *b)
+{
+    const CompressedVector *first = (const CompressedVector *) a;
+    const CompressedVector *second = (const CompressedVector *) b;
+    int len = first->len < second->len ? first->len : second->len;
+    int comparison = memcmp(first->elements, second->elements, (size_t) len);
+    if (comparison != EQUAL)
+    {
+        return comparison < 0 ? LESS : GREATER;
+    }
+    return compareCompressedTie(first, second);
+}
+
+/**
+ * @brief constructs a new empty VectorStore.
+ * @param encoding: the encoding of the elements.
+ * @param maxAbs: the largest absolute value of an element the store accepts.
+ * @return a new store. if creation failed, returns NULL.
+ */
+VectorStore *newVectorStore(VectorEncoding encoding, double maxAbs)
+{
+    if ((encoding != VECTOR_ENCODING_FLOAT32 && encoding != VECTOR_ENCODING_INT8) ||
+        !(maxAbs > 0))
+    {
+        return NULL;
+    }
+    VectorStore *store = (VectorStore *) calloc(1, sizeof(VectorStore));
+    if (store == NULL)
+    {
+        return NULL;
+    }
+    store->encoding = encoding;
+    // larger elements would round to an infinite float, and break the error bounds of the norms.
+    store->maxAbs = encoding == VECTOR_ENCODING_FLOAT32 && maxAbs > FLT_MAX ? FLT_MAX : maxAbs;
+    store->scale = store->maxAbs / INT8_LEVELS;
+    store->tree = newRBTree(encoding == VECTOR_ENCODING_INT8 ? compareInt8Vectors :
+                            compareFloat32Vectors, free);
+    if (store->tree == NULL)
+    {
+        free(store);
+        return NULL;
+    }
+    return store;
+}
+
+/**
+ * ForEach function that keeps the largest absolute value of the elements of pVector.
+ * @param pVector pointer to Vector
+ * @param pMaxAbs pointer to double
+ * @return 1 on success, 0 on failure (if pVector == NULL: failure).
+ */
+int keepMaxAbs(const void *pVector, void *pMaxAbs)
+{
+    const Vector *vector = (const Vector *) pVector;
+    if (vector == NULL)
+    {
+        return false;
+    }
+    double *maxAbs = (double *) pMaxAbs;
+    for (int i = 0; i < vector->len; i++)
+    {
+        if (fabs(vector->vector[i]) > *maxAbs)
+        {
+            *maxAbs = fabs(vector->vector[i]);
+        }
+    }
+    return true;
+}
+
+/**
+ * ForEach function that adds pVector to the store pStore.
+ * @param pVector pointer to Vector
+ * @param pStore pointer to VectorStore
+ * @return 1 on success, 0 on failure.
+ */
+int addToVectorStore(const void *pVector, void *pStore)
+{
+    return insertToVectorStore((VectorStore *) pStore, (const Vector *) pVector);
+}
+
+/**
+ * @brief constructs a new VectorStore of all the vectors of a tree, with the tightest scale for
+ * them.
+ * @param tree: a tree of Vectors.
+ * @param encoding: the encoding of the elements.
+ * @return a new store. if creation failed, returns NULL.
+ */
+VectorStore *newVectorStoreFromTree(const RBTree *tree, VectorEncoding encoding)
+{
+    double maxAbs = 0;
+    if (tree == NULL || !forEachRBTree(tree, keepMaxAbs, &maxAbs))
+    {
+        return NULL;
+    }
+    VectorStore *store = newVectorStore(encoding, maxAbs > 0 ? maxAbs : 1);
+    if (store == NULL)
+    {
+        return NULL;
+    }
+    if (!forEachRBTree(tree, addToVectorStore, store))
+    {
+        freeVectorStore(&store);
+        return NULL;
+    }
+    return store;
+}
+
+/**
+ * @brief add a vector to the store.
+ * @param store: the store to add a vector to.
+ * @param vector: the vector to add (borrowed).
+ * @return: 0 on failure, other on success.
+ */
+int insertToVectorStore(VectorStore *store, const Vector *vector)
+{
+    if (store == NULL)
+    {
+        return false;
+    }
+    CompressedVector *compressed = compressVector(store, vector);
+    if (compressed == NULL)
+    {
+        return false;
+    }
+    if (!insertToRBTree(store->tree, compressed))
+    {
+        free(compressed);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief remove a vector from the store.
+ * @param store: the store to remove a vector from.
+ * @param vector: vector to remove.
+ * @return: 0 on failure, other on success.
+ */
+int deleteFromVectorStore(VectorStore *store, const Vector *vector)
+{
+    if (store == NULL)
+    {
+        return false;
+    }
+    CompressedVector *key = compressVector(store, vector);
+    if (key == NULL)
+    {
+        return false;
+    }
+    void *removed = removeFromRBTree(store->tree, key);
+    free(key);
+    free(removed);
+    return removed != NULL;
+}
+
+/**
+ * @brief check whether the store contains this vector.
+ * @param store: the store to search in.
+ * @param vector: vector to check.
+ * @return: 0 if the vector is not in the store, other if it is.
+ */
+int VectorStoreContains(const VectorStore *store, const Vector *vector)
+{
+    if (store == NULL)
+    {
+        return false;
+    }
+    CompressedVector *key = compressVector(store, vector);
+    if (key == NULL)
+    {
+        return false;
+    }
+    int contains = RBTreeContains(store->tree, key);
+    free(key);
+    return contains;
+}
+
+//-------------- norm scans. ----------------
+
+/**
+ * @brief the norm of a float32 compressed vector. the loop keeps four independent sums, so the
+ * compiler can vectorize it.
+ * @param vector: the compressed vector.
+ * @return the norm (not squared).
+ */
+double float32Norm(const CompressedVector *vector)
+{
+    double sums[4] = {0, 0, 0, 0};
+    int i = 0;
+    for (; i + 4 <= vector->len; i += 4)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            double element = vector->elements[i + j];
+            sums[j] += element * element;
+        }
+    }
+    for (; i < vector->len; i++)
+    {
+        double element = vector->elements[i];
+        sums[0] += element * element;
+    }
+    return sqrt((sums[0] + sums[1]) + (sums[2] + sums[3]));
+}
+
+/**
+ * @brief the squared norm of the codes of an int8 compressed vector, computed exactly in integers.
+ * @param vector: the compressed vector.
+ * @return the squared norm of the codes.
+ */
+long long int8SquaredNorm(const CompressedVector *vector)
+{
+    const unsigned char *codes = (const unsigned char *) vector->elements;
+    long long sums[4] = {0, 0, 0, 0};
+    int i = 0;
+    for (; i + 4 <= vector->len; i += 4)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            int code = (int) codes[i + j] - INT8_BIAS;
+            sums[j] += code * code;
+        }
+    }
+    for (; i < vector->len; i++)
+    {
+        int code = (int) codes[i] - INT8_BIAS;
+        sums[0] += code * code;
+    }
+    return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+/**
+ * @brief the norm of a compressed vector, and how far the norm of the original can be from it.
+ * float32: every element is off by at most FLT_EPSILON / 2 of itself. int8: every element is off
+ * by at most half the scale, so the norm is off by at most sqrt(len) * scale / 2.
+ * @param store: the store.
+ * @param vector: the compressed vector.
+ * @param error: set to the bound of the error.
+ * @return the norm of the compressed vector (not squared).
+ */
+double compressedNorm(const VectorStore *store, const CompressedVector *vector, double *error)
+{
+    double norm;
+    if (store->encoding == VECTOR_ENCODING_FLOAT32)
+    {
+        norm = float32Norm(vector);
+        *error = norm * FLT_EPSILON + sqrt((double) vector->len) * FLT_MIN * FLT_EPSILON;
+    }
+    else
+    {
+        norm = store->scale * sqrt((double) int8SquaredNorm(vector));
+        *error = store->scale * sqrt((double) vector->len) / 2;
+    }
+    // room for the rounding of the computation itself.
+    *error = *error * (1 + 1e-6) + norm * 1e-12;
+    return norm;
+}
+
+/**
+ * a vector that may have the largest norm - the upper bound of its norm reaches the largest lower
+ * bound seen so far.
+ */
+typedef struct NormCandidate
+{
+    double upperBound;
+    const Vector *original;
+} NormCandidate;
+
+/**
+ * the state of a search for the vector with the largest norm in a store. a single pass over the
+ * compressed vectors keeps the largest lower bound of a norm and the candidates whose upper bound
+ * reaches it, and only the candidates are re-checked exactly, on the originals.
+ */
+typedef struct StoreNormSearch
+{
+    const VectorStore *store;
+    double lowerBound;
+    NormCandidate *candidates;
+    int numCandidates;
+    int capacity;
+} StoreNormSearch;
+
+/**
+ * @brief drops the candidates whose upper bound fell below the lower bound, keeping the order of
+ * the rest.
+ * @param search: the search.
+ */
+void pruneNormCandidates(StoreNormSearch *search)
+{
+    int kept = 0;
+    for (int i = 0; i < search->numCandidates; i++)
+    {
+        if (search->candidates[i].upperBound >= search->lowerBound)
+        {
+            search->candidates[kept++] = search->candidates[i];
+        }
+    }
+    search->numCandidates = kept;
+}
+
+/**
+ * ForEach function that raises the lower bound of the search by the norm of pVector, and keeps it
+ * as a candidate if it may be the largest.
+ * @param pVector pointer to CompressedVector
+ * @param pSearch pointer to StoreNormSearch
+ * @return 1 on success, 0 on failure.
+ */
+int offerNormCandidate(const void *pVector, void *pSearch)
+{
+    StoreNormSearch *search = (StoreNormSearch *) pSearch;
+    const CompressedVector *vector = (const CompressedVector *) pVector;
+    double error;
+    double norm = compressedNorm(search->store, vector, &error);
+    if (norm + error < search->lowerBound)
+    {
+        return true;
+    }
+    if (norm - error > search->lowerBound)
+    {
+        search->lowerBound = norm - error;
+    }
+    if (search->numCandidates == search->capacity)
+    {
+        // pruning when the list is full keeps it about as long as the live candidates.
+        pruneNormCandidates(search);
+        if (2 * search->numCandidates >= search->capacity)
+        {
+            int capacity = search->capacity == 0 ? INITIAL_CANDIDATES : 2 * search->capacity;
+            NormCandidate *grown = (NormCandidate *) realloc(search->candidates,
+                                                             capacity * sizeof(NormCandidate));
+            if (grown == NULL)
+            {
+                return false;
+            }
+            search->candidates = grown;
+            search->capacity = capacity;
+        }
+    }
+    search->candidates[search->numCandidates++] = (NormCandidate) {norm + error, vector->original};
+    return true;
+}
+
+/**
+ * @brief the squared norm of an original vector.
+ * @param vector: the vector.
+ * @return the squared norm.
+ */
+double exactSquaredNorm(const Vector *vector)
+{
+    double norm = 0;
+    for (int i = 0; i < vector->len; i++)
+    {
+        norm += vector->vector[i] * vector->vector[i];
+    }
+    return norm;
+}
+
+/**
+ * @brief finds the original vector with the largest norm.
+ * @param store: the store to search in.
+ * @return: the vector, borrowed. NULL if the store is empty.
+ */
+const Vector *findMaxNormVectorInStore(const VectorStore *store)
+{
+    if (store == NULL)
+    {
+        return NULL;
+    }
+    StoreNormSearch search = {store, -1, NULL, 0, 0};
+    if (!forEachRBTree(store->tree, offerNormCandidate, &search))
+    {
+        free(search.candidates);
+        return NULL;
+    }
+    pruneNormCandidates(&search);
+    const Vector *max = NULL;
+    double maxNorm = 0;
+    for (int i = 0; i < search.numCandidates; i++)
+    {
+        double norm = exactSquaredNorm(search.candidates[i].original);
+        if (max == NULL || norm > maxNorm)
+        {
+            max = search.candidates[i].original;
+            maxNorm = norm;
+        }
+    }
+    free(search.candidates);
+    return max;
+}
+
+/**
+ * @param store: the store.
+ * @return: number of vectors in the store.
+ */
+long unsigned vectorStoreSize(const VectorStore *store)
+{
+    return store == NULL ? 0 : store->tree->size;
+}
+
+/**
+ * @brief free the store (the original vectors are not freed).
+ * @param store: pointer to the store to free.
+ */
+void freeVectorStore(VectorStore **store)
+{
+    if (store == NULL || (*store) == NULL)
+    {
+        return;
+    }
+    freeRBTree(&(*store)->tree);
+    free(*store);
+    *store = NULL;
+}
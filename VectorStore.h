@@ -0,0 +1,89 @@
+#ifndef RBTREE_VECTORSTORE_H
+#define RBTREE_VECTORSTORE_H
+
+#include "RBTree.h"
+#include "Structs.h"
+
+/**
+ * the encoding of the elements of the vectors in a VectorStore.
+ * VECTOR_ENCODING_FLOAT32: every element is rounded to a float (half the memory of a double).
+ * VECTOR_ENCODING_INT8: every element is quantized to one byte, by a scale shared by the whole
+ * store (an eighth of the memory of a double).
+ */
+typedef enum VectorEncoding
+{
+	VECTOR_ENCODING_FLOAT32, VECTOR_ENCODING_INT8
+} VectorEncoding;
+
+/**
+ * a set of Vectors kept in a compressed form, so scans over it read 2-8 times less memory. the
+ * store borrows the original vectors - they are read only where the compressed form cannot decide
+ * (equal compressed vectors, or norms too close to tell apart), and must outlive the store.
+ * the vectors are ordered by their compressed elements, ties broken by the exact elements - a
+ * total order in which two vectors are equal iff they are equal by vectorCompare1By1, but not
+ * necessarily the same order.
+ */
+typedef struct VectorStore VectorStore;
+
+/**
+ * constructs a new empty VectorStore.
+ * @param encoding: the encoding of the elements.
+ * @param maxAbs: the largest absolute value of an element the store accepts. sets the scale of
+ * VECTOR_ENCODING_INT8, so it should be as tight as possible.
+ * @return a new store. if creation failed, returns NULL.
+ */
+VectorStore *newVectorStore(VectorEncoding encoding, double maxAbs);
+
+/**
+ * constructs a new VectorStore of all the vectors of a tree, with the tightest scale for them.
+ * @param tree: a tree of Vectors. its vectors must outlive the store.
+ * @param encoding: the encoding of the elements.
+ * @return a new store. if creation failed, returns NULL.
+ */
+VectorStore *newVectorStoreFromTree(const RBTree *tree, VectorEncoding encoding);
+
+/**
+ * add a vector to the store.
+ * @param store: the store to add a vector to.
+ * @param vector: the vector to add (borrowed).
+ * @return: 0 on failure, other on success. (if the vector is already in the store, or one of its
+ * elements is larger than the store accepts - failure).
+ */
+int insertToVectorStore(VectorStore *store, const Vector *vector);
+
+/**
+ * remove a vector from the store.
+ * @param store: the store to remove a vector from.
+ * @param vector: vector to remove.
+ * @return: 0 on failure, other on success. (if the vector is not in the store - failure).
+ */
+int deleteFromVectorStore(VectorStore *store, const Vector *vector);
+
+/**
+ * check whether the store contains this vector.
+ * @param store: the store to search in.
+ * @param vector: vector to check.
+ * @return: 0 if the vector is not in the store, other if it is.
+ */
+int VectorStoreContains(const VectorStore *store, const Vector *vector);
+
+/**
+ * @param store: the store to search in.
+ * @return: the original vector that has the largest norm (L2 Norm), borrowed (no copy is made).
+ * NULL if the store is empty.
+ */
+const Vector *findMaxNormVectorInStore(const VectorStore *store);
+
+/**
+ * @param store: the store.
+ * @return: number of vectors in the store.
+ */
+long unsigned vectorStoreSize(const VectorStore *store);
+
+/**
+ * free the store (the original vectors are not freed).
+ * @param store: pointer to the store to free.
+ */
+void freeVectorStore(VectorStore **store);
+
+#endif //RBTREE_VECTORSTORE_H